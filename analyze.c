@@ -0,0 +1,577 @@
+/*
+ * Student name : Or Zipori
+ * Student : 302933833
+ * Course Exercise Group : 03
+ * Exercise Name : ex3
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include "othello.h"
+#include "archive.h"
+#include "timer.h"
+
+#define DEFAULT_OPENING_PLIES 4
+#define DEFAULT_POSITION_PLY 20
+#define DEFAULT_TOP 10
+// the most plies an opening key holds, one byte each
+#define MAX_OPENING_PLIES 7
+// games a worker takes at once
+#define CHUNK 4096
+#define TABLE_START 1024
+
+/*
+ * games counted under one key - an opening (its moves packed one byte each)
+ * or a position (its zobrist hash). example is the first game that had it.
+ * an entry with no games is free.
+ */
+typedef struct {
+    uint64_t key;
+    uint64_t games;
+    uint64_t blackWins;
+    uint64_t whiteWins;
+    uint64_t draws;
+    uint64_t example;
+} Tally;
+
+// open addressing hash table of tallies, capacity is a power of 2
+typedef struct {
+    Tally *entries;
+    size_t capacity;
+    size_t used;
+} TallyTable;
+
+typedef struct {
+    const Archive *archive;
+    // the discs of the opening position
+    Bitboard start[3];
+    int openingPlies;
+    int positionPly;
+    // the next game to take
+    atomic_ullong next;
+} Analysis;
+
+/*
+ * a worker replays whole chunks of games and counts in its own tables, the
+ * tables of all the workers are merged once they are done.
+ */
+typedef struct {
+    Analysis *analysis;
+    pthread_t tid;
+    TallyTable openings;
+    TallyTable positions;
+    uint64_t games;
+    uint64_t results[NO_END + 1];
+    uint64_t moves;
+    uint64_t passes;
+    uint64_t durationMs;
+    // games with an illegal move, or that don't end as recorded
+    uint64_t illegal;
+} Worker;
+
+/*******************************************************************************
+* function name : exitWithError
+* input : message
+* output : -
+* explanation : write to stderr the message and exit with code -1
+*******************************************************************************/
+void exitWithError(char *msg) {
+    perror(msg);
+    exit(-1);
+}
+
+/*******************************************************************************
+* function name : tableInit
+* input : TallyTable *table
+* output : -
+* explanation : -
+*******************************************************************************/
+void tableInit(TallyTable *table) {
+    table->capacity = TABLE_START;
+    table->used = 0;
+    if (!(table->entries = calloc(table->capacity, sizeof(Tally)))) {
+        exitWithError("calloc error");
+    }
+}
+
+/*******************************************************************************
+* function name : tableFind
+* input : TallyTable *table, uint64_t key
+* output : the tally of key, a free entry if key isn't in the table
+* explanation : linear probing from the mixed key.
+*******************************************************************************/
+Tally *tableFind(TallyTable *table, uint64_t key) {
+    uint64_t state = key;
+    size_t mask = table->capacity - 1;
+    size_t i = splitMix64(&state) & mask;
+
+    while (table->entries[i].games && table->entries[i].key != key) {
+        i = (i + 1) & mask;
+    }
+
+    return &table->entries[i];
+}
+
+/*******************************************************************************
+* function name : tableGrow
+* input : TallyTable *table
+* output : -
+* explanation : double the table once it is half full.
+*******************************************************************************/
+void tableGrow(TallyTable *table) {
+    Tally *old = table->entries;
+    size_t capacity = table->capacity, i;
+
+    table->capacity *= 2;
+    if (!(table->entries = calloc(table->capacity, sizeof(Tally)))) {
+        exitWithError("calloc error");
+    }
+
+    for (i = 0; i < capacity; i++) {
+        if (old[i].games) {
+            *tableFind(table, old[i].key) = old[i];
+        }
+    }
+    free(old);
+}
+
+/*******************************************************************************
+* function name : tableAdd
+* input : TallyTable *table, const Tally *add
+* output : -
+* explanation : add the counts of add to the tally of its key.
+*******************************************************************************/
+void tableAdd(TallyTable *table, const Tally *add) {
+    Tally *t = tableFind(table, add->key);
+
+    if (!t->games) {
+        if (2 * (table->used + 1) > table->capacity) {
+            tableGrow(table);
+            t = tableFind(table, add->key);
+        }
+        *t = *add;
+        table->used++;
+        return;
+    }
+
+    t->games += add->games;
+    t->blackWins += add->blackWins;
+    t->whiteWins += add->whiteWins;
+    t->draws += add->draws;
+    if (add->example < t->example) {
+        t->example = add->example;
+    }
+}
+
+/*******************************************************************************
+* function name : compareGames
+* input : const void *a, const void *b - two tallies
+* output : the one with more games first
+* explanation : for qsort.
+*******************************************************************************/
+int compareGames(const void *a, const void *b) {
+    const Tally *x = (const Tally *) a, *y = (const Tally *) b;
+
+    if (x->games != y->games) {
+        return x->games > y->games ? -1 : 1;
+    }
+    return x->example < y->example ? -1 : x->example > y->example;
+}
+
+/*******************************************************************************
+* function name : movesText
+* input : const uint8_t moves[], int n, char *text
+* output : text
+* explanation : the moves as squares, "f5d6c3...", "--" for a pass. text
+*               must hold 2 * n + 1 chars.
+*******************************************************************************/
+char *movesText(const uint8_t moves[], int n, char *text) {
+    int i;
+
+    for (i = 0; i < n; i++) {
+        if (moves[i] == ARCHIVE_PASS) {
+            text[2 * i] = '-';
+            text[2 * i + 1] = '-';
+        } else {
+            text[2 * i] = 'a' + moves[i] % BOARD_SIZE;
+            text[2 * i + 1] = '1' + moves[i] / BOARD_SIZE;
+        }
+    }
+    text[2 * n] = '\0';
+
+    return text;
+}
+
+/*******************************************************************************
+* function name : positionHash
+* input : const Bitboard discs[3], int side
+* output : the zobrist hash of the discs with side to move
+* explanation : the hash a Position of the same discs has.
+*******************************************************************************/
+uint64_t positionHash(const Bitboard discs[3], int side) {
+    uint64_t hash = side == WHITE ? zobristSide : 0;
+    Bitboard b;
+
+    for (b = discs[WHITE]; b; b &= b - 1) {
+        hash ^= zobrist[WHITE][__builtin_ctzll(b)];
+    }
+    for (b = discs[BLACK]; b; b &= b - 1) {
+        hash ^= zobrist[BLACK][__builtin_ctzll(b)];
+    }
+
+    return hash;
+}
+
+/*******************************************************************************
+* function name : analyzeGame
+* input : Worker *w, uint64_t index
+* output : -
+* explanation : replay game index with the move rules and count it. only
+*               the discs are kept, the legal moves are generated just to
+*               check a pass and the end. written passes must be real ones,
+*               missing passes are played where they have to be.
+*******************************************************************************/
+void analyzeGame(Worker *w, uint64_t index) {
+    Analysis *analysis = w->analysis;
+    GameRecord record;
+    const uint8_t *moves;
+    Tally tally;
+    Bitboard discs[3];
+    uint64_t opening = 0, position = 0;
+    Boolean reached = FALSE;
+    int side = BLACK, ply = 0, i;
+
+    if (archiveGame(analysis->archive, index, &record, &moves) < 0) {
+        w->illegal++;
+        return;
+    }
+
+    memcpy(discs, analysis->start, sizeof(discs));
+    for (i = 0; i < record.moveCount; i++) {
+        int sq = moves[i], opp = OPPONENT(side);
+        Bitboard flips;
+
+        if (sq == ARCHIVE_PASS) {
+            if (generateMoves(discs[side], discs[opp])) {
+                break;
+            }
+            side = opp;
+            w->passes++;
+        } else {
+            if (sq >= SQUARES || ((discs[WHITE] | discs[BLACK]) & SQUARE_BIT(sq))) {
+                break;
+            }
+
+            if ((flips = computeFlips(discs[side], discs[opp], sq))) {
+                discs[side] |= flips | SQUARE_BIT(sq);
+                discs[opp] &= ~flips;
+                side = opp;
+            } else {
+                // no flips is an illegal move or a pass that wasn't written.
+                // the pass is counted like a written one and the move is
+                // played again after it
+                if (generateMoves(discs[side], discs[opp]) ||
+                    !computeFlips(discs[opp], discs[side], sq)) {
+                    break;
+                }
+                sq = ARCHIVE_PASS;
+                side = opp;
+                w->passes++;
+                i--;
+            }
+        }
+        ply++;
+
+        if (ply <= analysis->openingPlies) {
+            opening = opening << 8 | (sq + 1);
+        }
+
+        if (ply == analysis->positionPly) {
+            position = positionHash(discs, side);
+            reached = TRUE;
+        }
+    }
+
+    // the game must end where the record does, with its result
+    if (i < record.moveCount ||
+        generateMoves(discs[WHITE], discs[BLACK]) ||
+        generateMoves(discs[BLACK], discs[WHITE]) ||
+        record.result != (countDiscs(discs[WHITE]) > countDiscs(discs[BLACK]) ?
+                          WHITE_WIN : countDiscs(discs[WHITE]) <
+                          countDiscs(discs[BLACK]) ? BLACK_WIN : DRAW)) {
+        w->illegal++;
+        return;
+    }
+
+    w->games++;
+    w->results[record.result]++;
+    w->moves += countDiscs(discs[WHITE] | discs[BLACK]) - 4;
+    w->durationMs += record.durationMs;
+
+    memset(&tally, 0, sizeof(tally));
+    tally.games = 1;
+    tally.example = index;
+
+    if (reached) {
+        tally.key = position;
+        tableAdd(&w->positions, &tally);
+    }
+
+    tally.key = opening;
+    tally.blackWins = record.result == BLACK_WIN;
+    tally.whiteWins = record.result == WHITE_WIN;
+    tally.draws = record.result == DRAW;
+    tableAdd(&w->openings, &tally);
+}
+
+/*******************************************************************************
+* function name : workerThread
+* input : void *arg - the Worker
+* output : NULL
+* explanation : take chunks of games until all the games are taken. the
+*               games of a chunk are next to each other in the archive, so
+*               it is read in order.
+*******************************************************************************/
+void *workerThread(void *arg) {
+    Worker *w = (Worker *) arg;
+    Analysis *analysis = w->analysis;
+    uint64_t count = analysis->archive->count, first, i;
+
+    while ((first = atomic_fetch_add(&analysis->next, CHUNK)) < count) {
+        uint64_t last = first + CHUNK < count ? first + CHUNK : count;
+        for (i = first; i < last; i++) {
+            analyzeGame(w, i);
+        }
+    }
+
+    return NULL;
+}
+
+/*******************************************************************************
+* function name : sortedTallies
+* input : const TallyTable *table
+* output : the tallies of the table, most games first
+* explanation : the caller frees the result.
+*******************************************************************************/
+Tally *sortedTallies(const TallyTable *table) {
+    Tally *sorted = malloc((table->used + 1) * sizeof(Tally));
+    size_t i, n = 0;
+
+    if (!sorted) {
+        exitWithError("malloc error");
+    }
+
+    for (i = 0; i < table->capacity; i++) {
+        if (table->entries[i].games) {
+            sorted[n++] = table->entries[i];
+        }
+    }
+    qsort(sorted, n, sizeof(Tally), compareGames);
+
+    return sorted;
+}
+
+/*******************************************************************************
+* function name : printOpenings
+* input : const Analysis *analysis, const TallyTable *table, int top
+* output : -
+* explanation : the openings played most, with the results of each.
+*******************************************************************************/
+void printOpenings(const Analysis *analysis, const TallyTable *table, int top) {
+    Tally *sorted = sortedTallies(table);
+    size_t i;
+
+    printf("\nopenings played most (first %d plies):\n", analysis->openingPlies);
+    for (i = 0; i < table->used && i < (size_t) top; i++) {
+        const Tally *t = &sorted[i];
+        GameRecord record;
+        const uint8_t *moves;
+        char text[2 * MAX_OPENING_PLIES + 1];
+        int n;
+
+        if (archiveGame(analysis->archive, t->example, &record, &moves) < 0) {
+            continue;
+        }
+        n = record.moveCount < analysis->openingPlies ? record.moveCount :
+            analysis->openingPlies;
+        printf("  %-*s %10llu games  black %5.1f%%  white %5.1f%%  draw %5.1f%%\n",
+               2 * analysis->openingPlies, movesText(moves, n, text),
+               (unsigned long long) t->games, 100.0 * t->blackWins / t->games,
+               100.0 * t->whiteWins / t->games, 100.0 * t->draws / t->games);
+    }
+
+    free(sorted);
+}
+
+/*******************************************************************************
+* function name : printPositions
+* input : const Analysis *analysis, const TallyTable *table, int top
+* output : -
+* explanation : the positions seen most at the position ply, each with the
+*               moves of the first game that reached it.
+*******************************************************************************/
+void printPositions(const Analysis *analysis, const TallyTable *table, int top) {
+    Tally *sorted = sortedTallies(table);
+    size_t i;
+
+    printf("\npositions seen most at ply %d:\n", analysis->positionPly);
+    for (i = 0; i < table->used && i < (size_t) top; i++) {
+        const Tally *t = &sorted[i];
+        GameRecord record;
+        const uint8_t *moves;
+        char text[2 * ARCHIVE_MAX_MOVES + 1];
+        int n;
+
+        if (archiveGame(analysis->archive, t->example, &record, &moves) < 0) {
+            continue;
+        }
+        n = record.moveCount < analysis->positionPly ? record.moveCount :
+            analysis->positionPly;
+        printf("  %016llx %10llu games, first in game %llu: %s\n",
+               (unsigned long long) t->key, (unsigned long long) t->games,
+               (unsigned long long) t->example, movesText(moves, n, text));
+    }
+
+    free(sorted);
+}
+
+/*******************************************************************************
+* function name : main
+* input : int argc, char **argv
+* output : 0
+* explanation : analyze [-j workers] [-p plies] [-m ply] [-n top] archive
+*               replays every game of the archive and prints the results,
+*               the openings of -p plies and the positions at ply -m that
+*               were played most.
+*******************************************************************************/
+int main(int argc, char **argv) {
+    Analysis analysis;
+    Archive archive;
+    Position pos;
+    Worker *workers;
+    uint64_t games = 0, moves = 0, passes = 0, durationMs = 0, illegal = 0;
+    uint64_t results[NO_END + 1] = {0};
+    int count = sysconf(_SC_NPROCESSORS_ONLN), top = DEFAULT_TOP;
+    long long start;
+    double seconds;
+    int opt, i, r;
+
+    analysis.openingPlies = DEFAULT_OPENING_PLIES;
+    analysis.positionPly = DEFAULT_POSITION_PLY;
+    while ((opt = getopt(argc, argv, "j:p:m:n:")) != -1) {
+        switch (opt) {
+            case 'j': count = atoi(optarg);
+                break;
+            case 'p': analysis.openingPlies = atoi(optarg);
+                break;
+            case 'm': analysis.positionPly = atoi(optarg);
+                break;
+            case 'n': top = atoi(optarg);
+                break;
+            default:
+                optind = argc + 1;
+        }
+    }
+
+    if (optind != argc - 1) {
+        fprintf(stderr, "usage: %s [-j workers] [-p plies] [-m ply] [-n top] "
+                "archive\n", argv[0]);
+        exit(-1);
+    }
+
+    if (count < 1) count = 1;
+    if (analysis.openingPlies < 0) analysis.openingPlies = 0;
+    if (analysis.openingPlies > MAX_OPENING_PLIES) {
+        analysis.openingPlies = MAX_OPENING_PLIES;
+    }
+
+    if (archiveOpen(&archive, argv[optind]) < 0) {
+        exitWithError("archive error");
+    }
+    // every page is read once, in order
+    madvise(archive.data, archive.dataSize, MADV_SEQUENTIAL);
+    madvise(archive.index, archive.indexSize, MADV_SEQUENTIAL);
+
+    // the keys are filled before the workers share them
+    initPosition(&pos);
+    memcpy(analysis.start, pos.discs, sizeof(analysis.start));
+    analysis.archive = &archive;
+    atomic_init(&analysis.next, 0);
+
+    if (!(workers = calloc(count, sizeof(Worker)))) {
+        exitWithError("calloc error");
+    }
+
+    start = nowNs();
+    for (i = 0; i < count; i++) {
+        workers[i].analysis = &analysis;
+        tableInit(&workers[i].openings);
+        tableInit(&workers[i].positions);
+        if (pthread_create(&workers[i].tid, NULL, workerThread, &workers[i]) != 0) {
+            exitWithError("pthread_create error");
+        }
+    }
+
+    // the tables of all the workers go into the first one's
+    for (i = 0; i < count; i++) {
+        Worker *w = &workers[i];
+        size_t k;
+
+        pthread_join(w->tid, NULL);
+        games += w->games;
+        moves += w->moves;
+        passes += w->passes;
+        durationMs += w->durationMs;
+        illegal += w->illegal;
+        for (r = 0; r <= NO_END; r++) {
+            results[r] += w->results[r];
+        }
+
+        if (i == 0) {
+            continue;
+        }
+        for (k = 0; k < w->openings.capacity; k++) {
+            if (w->openings.entries[k].games) {
+                tableAdd(&workers[0].openings, &w->openings.entries[k]);
+            }
+        }
+        for (k = 0; k < w->positions.capacity; k++) {
+            if (w->positions.entries[k].games) {
+                tableAdd(&workers[0].positions, &w->positions.entries[k]);
+            }
+        }
+        free(w->openings.entries);
+        free(w->positions.entries);
+    }
+    seconds = (nowNs() - start) / 1e9;
+
+    printf("%llu games replayed in %.3f seconds by %d workers, %.0f games/sec, "
+           "%.0f moves/sec\n", (unsigned long long) archive.count, seconds, count,
+           seconds > 0 ? archive.count / seconds : 0.0,
+           seconds > 0 ? moves / seconds : 0.0);
+    if (illegal) {
+        printf("%llu games skipped, they have an illegal move or don't end as "
+               "recorded\n", (unsigned long long) illegal);
+    }
+
+    if (games) {
+        printf("black wins %.1f%%, white wins %.1f%%, draws %.1f%%\n",
+               100.0 * results[BLACK_WIN] / games, 100.0 * results[WHITE_WIN] / games,
+               100.0 * results[DRAW] / games);
+        printf("average game: %.1f moves, %.2f passes, %.0f ms\n",
+               (double) moves / games, (double) passes / games,
+               (double) durationMs / games);
+        printOpenings(&analysis, &workers[0].openings, top);
+        printPositions(&analysis, &workers[0].positions, top);
+    }
+
+    free(workers[0].openings.entries);
+    free(workers[0].positions.entries);
+    free(workers);
+    archiveClose(&archive);
+
+    return 0;
+}
@@ -0,0 +1,329 @@
+/*
+ * Student name : Or Zipori
+ * Student : 302933833
+ * Course Exercise Group : 03
+ * Exercise Name : ex3
+ */
+#ifndef ARCHIVE_H
+#define ARCHIVE_H
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/file.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#define ARCHIVE_MAGIC 0x31524147u  // "GAR1"
+#define ARCHIVE_INDEX_MAGIC 0x31584449u  // "IDX1"
+#define ARCHIVE_VERSION 1
+#define ARCHIVE_INDEX_SUFFIX ".idx"
+// a move is a square 0-63 or a pass, like the moves of othello.h
+#define ARCHIVE_PASS 64
+#define ARCHIVE_MAX_MOVES 255
+
+/*
+ * an archive is two append only files. the games file is a header and then
+ * the games, each a GameRecord followed by one byte per move. the index
+ * file (the games file's name and ".idx") is a header and then the offset
+ * of every game in the games file, so game n is found with one lookup. a
+ * game is written before its offset, so a reader only ever sees whole
+ * games, and several processes may add to one archive.
+ */
+typedef struct {
+    uint32_t magic;
+    uint32_t version;
+} ArchiveHeader;
+
+typedef struct {
+    // when the game started, in milliseconds since the epoch
+    uint64_t startMs;
+    uint32_t durationMs;
+    // BLACK_WIN, WHITE_WIN or DRAW
+    uint8_t result;
+    uint8_t moveCount;
+    uint16_t unused;
+} GameRecord;
+
+typedef struct {
+    int dataFD;
+    int indexFD;
+} ArchiveWriter;
+
+/*
+ * an archive mapped read only. the records are packed, so they are not
+ * aligned - archiveGame copies the record out.
+ */
+typedef struct {
+    void *data;
+    size_t dataSize;
+    void *index;
+    size_t indexSize;
+    const uint64_t *offsets;
+    uint64_t count;
+} Archive;
+
+/*******************************************************************************
+* function name : archiveIndexPath
+* input : const char *path, char *out, size_t size
+* output : 0 on success, -1 if the name is too long
+* explanation : the name of the index file of the archive path.
+*******************************************************************************/
+static inline int archiveIndexPath(const char *path, char *out, size_t size) {
+    if ((size_t) snprintf(out, size, "%s%s", path, ARCHIVE_INDEX_SUFFIX) >= size) {
+        errno = ENAMETOOLONG;
+        return -1;
+    }
+    return 0;
+}
+
+/*******************************************************************************
+* function name : archiveCheckHeader
+* input : int fd, uint32_t magic
+* output : 0 if the file is empty or starts with magic, -1 otherwise
+* explanation : an empty file gets its header.
+*******************************************************************************/
+static inline int archiveCheckHeader(int fd, uint32_t magic) {
+    ArchiveHeader header;
+    struct stat st;
+
+    if (fstat(fd, &st) < 0) {
+        return -1;
+    }
+
+    if (st.st_size == 0) {
+        header.magic = magic;
+        header.version = ARCHIVE_VERSION;
+        return write(fd, &header, sizeof(header)) == sizeof(header) ? 0 : -1;
+    }
+
+    if (pread(fd, &header, sizeof(header), 0) != sizeof(header) ||
+        header.magic != magic || header.version != ARCHIVE_VERSION) {
+        errno = EINVAL;
+        return -1;
+    }
+
+    return 0;
+}
+
+/*******************************************************************************
+* function name : archiveWriterOpen
+* input : ArchiveWriter *w, const char *path
+* output : 0 on success, -1 on failure (errno is set)
+* explanation : open the archive path for adding games, it is created if
+*               it doesn't exist.
+*******************************************************************************/
+static inline int archiveWriterOpen(ArchiveWriter *w, const char *path) {
+    char indexPath[4096];
+    int flags = O_RDWR | O_CREAT | O_APPEND | O_CLOEXEC;
+    int ok;
+
+    w->dataFD = w->indexFD = -1;
+    if (archiveIndexPath(path, indexPath, sizeof(indexPath)) < 0 ||
+        (w->dataFD = open(path, flags, 0644)) < 0) {
+        return -1;
+    }
+    if ((w->indexFD = open(indexPath, flags, 0644)) < 0) {
+        close(w->dataFD);
+        return -1;
+    }
+
+    // another process may be creating the same archive
+    flock(w->dataFD, LOCK_EX);
+    ok = archiveCheckHeader(w->dataFD, ARCHIVE_MAGIC) == 0 &&
+         archiveCheckHeader(w->indexFD, ARCHIVE_INDEX_MAGIC) == 0;
+    flock(w->dataFD, LOCK_UN);
+
+    if (!ok) {
+        int error = errno;
+        close(w->dataFD);
+        close(w->indexFD);
+        errno = error;
+        return -1;
+    }
+
+    return 0;
+}
+
+/*******************************************************************************
+* function name : archiveAppend
+* input : ArchiveWriter *w, const uint8_t moves[], int n, int result,
+*         uint64_t startMs, uint32_t durationMs
+* output : 0 on success, -1 on failure
+* explanation : add one game with one write to each file. the lock keeps
+*               the games of other processes from coming between the two,
+*               the threads of one process must take turns themselves.
+*******************************************************************************/
+static inline int archiveAppend(ArchiveWriter *w, const uint8_t moves[], int n,
+                                int result, uint64_t startMs, uint32_t durationMs) {
+    uint8_t buf[sizeof(GameRecord) + ARCHIVE_MAX_MOVES];
+    GameRecord record;
+    struct stat st;
+    uint64_t offset;
+    size_t size;
+    int ok;
+
+    if (n < 0 || n > ARCHIVE_MAX_MOVES) {
+        errno = EINVAL;
+        return -1;
+    }
+
+    memset(&record, 0, sizeof(record));
+    record.startMs = startMs;
+    record.durationMs = durationMs;
+    record.result = (uint8_t) result;
+    record.moveCount = (uint8_t) n;
+    memcpy(buf, &record, sizeof(record));
+    memcpy(buf + sizeof(record), moves, n);
+    size = sizeof(record) + n;
+
+    flock(w->dataFD, LOCK_EX);
+    ok = fstat(w->dataFD, &st) == 0;
+    offset = ok ? (uint64_t) st.st_size : 0;
+    // a game cut short by a failed write is left out of the index
+    ok = ok && write(w->dataFD, buf, size) == (ssize_t) size &&
+         write(w->indexFD, &offset, sizeof(offset)) == sizeof(offset);
+    flock(w->dataFD, LOCK_UN);
+
+    return ok ? 0 : -1;
+}
+
+/*******************************************************************************
+* function name : archiveWriterClose
+* input : ArchiveWriter *w
+* output : -
+* explanation : -
+*******************************************************************************/
+static inline void archiveWriterClose(ArchiveWriter *w) {
+    if (w->dataFD >= 0) {
+        close(w->dataFD);
+        close(w->indexFD);
+        w->dataFD = w->indexFD = -1;
+    }
+}
+
+/*******************************************************************************
+* function name : archiveMap
+* input : const char *path, uint32_t magic, size_t *size
+* output : the file mapped read only, NULL on failure (errno is set)
+* explanation : the file must start with the header of magic.
+*******************************************************************************/
+static inline void *archiveMap(const char *path, uint32_t magic, size_t *size) {
+    const ArchiveHeader *header;
+    struct stat st;
+    void *map;
+    int fd;
+
+    if ((fd = open(path, O_RDONLY | O_CLOEXEC)) < 0) {
+        return NULL;
+    }
+
+    if (fstat(fd, &st) < 0) {
+        close(fd);
+        return NULL;
+    }
+
+    if ((size_t) st.st_size < sizeof(ArchiveHeader)) {
+        close(fd);
+        errno = EINVAL;
+        return NULL;
+    }
+
+    *size = st.st_size;
+    map = mmap(NULL, *size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED) {
+        return NULL;
+    }
+
+    header = (const ArchiveHeader *) map;
+    if (header->magic != magic || header->version != ARCHIVE_VERSION) {
+        munmap(map, *size);
+        errno = EINVAL;
+        return NULL;
+    }
+
+    return map;
+}
+
+/*******************************************************************************
+* function name : archiveOpen
+* input : Archive *a, const char *path
+* output : 0 on success, -1 on failure (errno is set)
+* explanation : map the archive path read only. the games added after this
+*               aren't seen.
+*******************************************************************************/
+static inline int archiveOpen(Archive *a, const char *path) {
+    char indexPath[4096];
+
+    a->data = a->index = NULL;
+    a->count = 0;
+
+    // the index first, every game it has is then in the games file
+    if (archiveIndexPath(path, indexPath, sizeof(indexPath)) < 0 ||
+        !(a->index = archiveMap(indexPath, ARCHIVE_INDEX_MAGIC, &a->indexSize))) {
+        return -1;
+    }
+
+    if (!(a->data = archiveMap(path, ARCHIVE_MAGIC, &a->dataSize))) {
+        int error = errno;
+        munmap(a->index, a->indexSize);
+        a->index = NULL;
+        errno = error;
+        return -1;
+    }
+
+    a->offsets = (const uint64_t *) ((const ArchiveHeader *) a->index + 1);
+    a->count = (a->indexSize - sizeof(ArchiveHeader)) / sizeof(uint64_t);
+    return 0;
+}
+
+/*******************************************************************************
+* function name : archiveClose
+* input : Archive *a
+* output : -
+* explanation : -
+*******************************************************************************/
+static inline void archiveClose(Archive *a) {
+    if (a->data) {
+        munmap(a->data, a->dataSize);
+        munmap(a->index, a->indexSize);
+        a->data = a->index = NULL;
+    }
+}
+
+/*******************************************************************************
+* function name : archiveGame
+* input : const Archive *a, uint64_t n, GameRecord *record,
+*         const uint8_t **moves
+* output : 0 on success, -1 if there is no game n
+* explanation : game n of the archive, its moves are left in the mapping.
+*******************************************************************************/
+static inline int archiveGame(const Archive *a, uint64_t n, GameRecord *record,
+                              const uint8_t **moves) {
+    uint64_t offset;
+
+    if (n >= a->count) {
+        return -1;
+    }
+
+    offset = a->offsets[n];
+    // a truncated file may be shorter than a record, nothing may wrap around
+    if (offset < sizeof(ArchiveHeader) || offset > a->dataSize ||
+        a->dataSize - offset < sizeof(GameRecord)) {
+        return -1;
+    }
+
+    memcpy(record, (const uint8_t *) a->data + offset, sizeof(GameRecord));
+    if (record->moveCount > a->dataSize - offset - sizeof(GameRecord)) {
+        return -1;
+    }
+
+    *moves = (const uint8_t *) a->data + offset + sizeof(GameRecord);
+    return 0;
+}
+
+#endif
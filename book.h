@@ -0,0 +1,174 @@
+/*
+ * Student name : Or Zipori
+ * Student : 302933833
+ * Course Exercise Group : 03
+ * Exercise Name : ex3
+ */
+#ifndef BOOK_H
+#define BOOK_H
+
+#include <stdint.h>
+#include <errno.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "othello.h"
+
+#define BOOK_MAGIC 0x314b4f42u  // "BOK1"
+#define BOOK_VERSION 1
+// a book move is played only if it was seen in this many games
+#define BOOK_MIN_GAMES 2
+
+/*
+ * the book file is a header followed by entries sorted by (hash, move).
+ * hash is the zobrist hash of the position before the move, the counts are
+ * the results of the games for the side that played it. the file is used
+ * as it is on disk - it is mapped read only and searched in place, so all
+ * the players on a host share one copy in the page cache.
+ */
+typedef struct {
+    uint32_t magic;
+    uint32_t version;
+    uint64_t count;
+} BookHeader;
+
+typedef struct {
+    uint64_t hash;
+    uint32_t games;
+    uint32_t wins;
+    uint32_t draws;
+    uint8_t move;
+    uint8_t unused[3];
+} BookEntry;
+
+typedef struct {
+    void *map;
+    size_t size;
+    const BookEntry *entries;
+    uint64_t count;
+} OpeningBook;
+
+/*******************************************************************************
+* function name : bookOpen
+* input : OpeningBook *book, const char *path
+* output : 0 on success, -1 on failure (errno is set)
+* explanation : map the book file read only.
+*******************************************************************************/
+static inline int bookOpen(OpeningBook *book, const char *path) {
+    const BookHeader *header;
+    struct stat st;
+    int fd;
+
+    book->map = NULL;
+    book->count = 0;
+
+    if ((fd = open(path, O_RDONLY)) < 0) {
+        return -1;
+    }
+
+    if (fstat(fd, &st) < 0) {
+        close(fd);
+        return -1;
+    }
+
+    if ((size_t) st.st_size < sizeof(BookHeader)) {
+        close(fd);
+        errno = EINVAL;
+        return -1;
+    }
+
+    book->size = st.st_size;
+    book->map = mmap(NULL, book->size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (book->map == MAP_FAILED) {
+        book->map = NULL;
+        return -1;
+    }
+
+    header = (const BookHeader *) book->map;
+    if (header->magic != BOOK_MAGIC || header->version != BOOK_VERSION ||
+        sizeof(BookHeader) + header->count * sizeof(BookEntry) > book->size) {
+        munmap(book->map, book->size);
+        book->map = NULL;
+        errno = EINVAL;
+        return -1;
+    }
+
+    book->entries = (const BookEntry *) (header + 1);
+    book->count = header->count;
+    madvise(book->map, book->size, MADV_RANDOM);
+    return 0;
+}
+
+/*******************************************************************************
+* function name : bookClose
+* input : OpeningBook *book
+* output : -
+* explanation : -
+*******************************************************************************/
+static inline void bookClose(OpeningBook *book) {
+    if (book->map) {
+        munmap(book->map, book->size);
+        book->map = NULL;
+    }
+}
+
+/*******************************************************************************
+* function name : bookFind
+* input : const OpeningBook *book, uint64_t hash
+* output : index of the first entry of hash, book->count if none
+* explanation : binary search.
+*******************************************************************************/
+static inline uint64_t bookFind(const OpeningBook *book, uint64_t hash) {
+    uint64_t lo = 0, hi = book->count;
+
+    while (lo < hi) {
+        uint64_t mid = lo + (hi - lo) / 2;
+        if (book->entries[mid].hash < hash) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+
+    return (lo < book->count && book->entries[lo].hash == hash) ? lo : book->count;
+}
+
+/*******************************************************************************
+* function name : bookMove
+* input : const OpeningBook *book, const Position *pos
+* output : the book move of pos, -1 if there is none
+* explanation : the legal move with the best score (a draw is half a win)
+*               among those played in at least BOOK_MIN_GAMES games.
+*******************************************************************************/
+static inline int bookMove(const OpeningBook *book, const Position *pos) {
+    uint64_t i;
+    int best = -1;
+    double bestScore = -1;
+
+    if (!book->map) {
+        return -1;
+    }
+
+    for (i = bookFind(book, pos->hash);
+         i < book->count && book->entries[i].hash == pos->hash; i++) {
+        const BookEntry *e = &book->entries[i];
+        double score;
+
+        if (e->games < BOOK_MIN_GAMES || e->move >= SQUARES ||
+            !(pos->legalMoves & SQUARE_BIT(e->move))) {
+            continue;
+        }
+
+        score = (e->wins + 0.5 * e->draws) / e->games;
+        if (score > bestScore) {
+            bestScore = score;
+            best = e->move;
+        }
+    }
+
+    return best;
+}
+
+#endif
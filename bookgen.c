@@ -0,0 +1,362 @@
+/*
+ * Student name : Or Zipori
+ * Student : 302933833
+ * Course Exercise Group : 03
+ * Exercise Name : ex3
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <ctype.h>
+#include "othello.h"
+#include "book.h"
+
+#define DEFAULT_BOOK_PLIES 20
+#define MAX_LINE 1024
+#define INITIAL_SLOTS 4096
+
+/*
+ * the (position, move) pairs being counted, in an open addressing table
+ * that grows when it is half full.
+ */
+typedef struct {
+    BookEntry *slots;
+    uint64_t capacity;
+    uint64_t used;
+} BookTable;
+
+/*******************************************************************************
+* function name : exitWithError
+* input : message
+* output : -
+* explanation : write to stderr the message and exit with code -1
+*******************************************************************************/
+void exitWithError(char *msg) {
+    perror(msg);
+    exit(-1);
+}
+
+/*******************************************************************************
+* function name : slotOf
+* input : BookTable *table, uint64_t hash, int move
+* output : the slot of (hash, move), a free slot if it is not counted yet
+* explanation : linear probing.
+*******************************************************************************/
+BookEntry *slotOf(BookTable *table, uint64_t hash, int move) {
+    uint64_t i = (hash ^ ((uint64_t) move * 0x9e3779b97f4a7c15ULL)) &
+                 (table->capacity - 1);
+
+    while (table->slots[i].games &&
+           (table->slots[i].hash != hash || table->slots[i].move != move)) {
+        i = (i + 1) & (table->capacity - 1);
+    }
+
+    return &table->slots[i];
+}
+
+/*******************************************************************************
+* function name : addCounts
+* input : BookTable *table, const BookEntry *e
+* output : -
+* explanation : add the games of e to the table.
+*******************************************************************************/
+void addCounts(BookTable *table, const BookEntry *e) {
+    BookEntry *slot;
+
+    // keep the table at most half full
+    if (2 * (table->used + 1) > table->capacity) {
+        BookTable bigger;
+        uint64_t i;
+
+        bigger.capacity = table->capacity * 2;
+        bigger.used = 0;
+        if (!(bigger.slots = calloc(bigger.capacity, sizeof(BookEntry)))) {
+            exitWithError("calloc error");
+        }
+
+        for (i = 0; i < table->capacity; i++) {
+            if (table->slots[i].games) {
+                *slotOf(&bigger, table->slots[i].hash, table->slots[i].move) =
+                    table->slots[i];
+                bigger.used++;
+            }
+        }
+
+        free(table->slots);
+        *table = bigger;
+    }
+
+    slot = slotOf(table, e->hash, e->move);
+    if (!slot->games) {
+        slot->hash = e->hash;
+        slot->move = e->move;
+        table->used++;
+    }
+    slot->games += e->games;
+    slot->wins += e->wins;
+    slot->draws += e->draws;
+}
+
+/*******************************************************************************
+* function name : parseGame
+* input : const char *line, int moves[]
+* output : number of moves, -1 if the line is not a game
+* explanation : a game is a list of squares like "f5d6c3", spaces allowed.
+*               "pa" or "--" is a pass, passes may also be left out.
+*******************************************************************************/
+int parseGame(const char *line, int moves[]) {
+    int n = 0;
+
+    while (*line) {
+        int sq;
+
+        if (isspace((unsigned char) *line)) {
+            line++;
+            continue;
+        }
+
+        if (*line == '#') {
+            break;
+        }
+
+        if (!strncmp(line, "pa", 2) || !strncmp(line, "--", 2)) {
+            sq = PASS_MOVE;
+        } else if ((sq = parseSquare(line)) < 0) {
+            return -1;
+        }
+
+        if (n == MAX_PLIES) {
+            return -1;
+        }
+        moves[n++] = sq;
+        line += 2;
+    }
+
+    return n;
+}
+
+/*******************************************************************************
+* function name : addGame
+* input : BookTable *table, const int moves[], int n, int plies
+* output : 0 if the game was added, -1 if it has an illegal move, -2 if it
+*          stops before the end
+* explanation : play the whole game for its result, then count the first
+*               plies moves.
+*******************************************************************************/
+int addGame(BookTable *table, const int moves[], int n, int plies) {
+    Position pos;
+    EndMode result;
+    int i;
+
+    initPosition(&pos);
+    for (i = 0; i < n; i++) {
+        // a written pass must be a real one
+        if (moves[i] == PASS_MOVE) {
+            if (!mustPass(&pos)) {
+                return -1;
+            }
+            makePass(&pos);
+            continue;
+        }
+
+        if (mustPass(&pos)) {
+            makePass(&pos);
+        }
+
+        if (!makeMove(&pos, moves[i])) {
+            return -1;
+        }
+    }
+
+    // a game cut short has no result to count
+    if (pos.legalMoves || mustPass(&pos)) {
+        return -2;
+    }
+    result = positionResult(&pos);
+
+    initPosition(&pos);
+    for (i = 0; i < n && pos.ply < plies; i++) {
+        BookEntry e;
+        int player;
+
+        if (mustPass(&pos)) {
+            makePass(&pos);
+        }
+
+        // the pass was already played
+        if (moves[i] == PASS_MOVE) {
+            continue;
+        }
+
+        player = pos.sideToMove;
+        memset(&e, 0, sizeof(e));
+        e.hash = pos.hash;
+        e.move = moves[i];
+        e.games = 1;
+        e.wins = (result == BLACK_WIN && player == BLACK) ||
+                 (result == WHITE_WIN && player == WHITE);
+        e.draws = (result == DRAW);
+        addCounts(table, &e);
+
+        makeMove(&pos, moves[i]);
+    }
+
+    return 0;
+}
+
+/*******************************************************************************
+* function name : compareEntries
+* input : const void *a, const void *b
+* output : order of two entries by (hash, move)
+* explanation : qsort comparator.
+*******************************************************************************/
+int compareEntries(const void *a, const void *b) {
+    const BookEntry *x = a, *y = b;
+
+    if (x->hash != y->hash) return (x->hash < y->hash) ? -1 : 1;
+    return (int) x->move - (int) y->move;
+}
+
+/*******************************************************************************
+* function name : writeBook
+* input : BookTable *table, const char *path
+* output : -
+* explanation : write the sorted book next to path and rename it over path,
+*               so players that mapped the old book keep a whole file.
+*******************************************************************************/
+void writeBook(BookTable *table, const char *path) {
+    BookHeader header;
+    char tmpPath[MAX_LINE];
+    uint64_t i, n = 0;
+    FILE *out;
+
+    // pack the used slots to the front and sort them
+    for (i = 0; i < table->capacity; i++) {
+        if (table->slots[i].games) {
+            table->slots[n++] = table->slots[i];
+        }
+    }
+    qsort(table->slots, n, sizeof(BookEntry), compareEntries);
+
+    snprintf(tmpPath, sizeof(tmpPath), "%s.tmp", path);
+    if (!(out = fopen(tmpPath, "wb"))) {
+        exitWithError("fopen error");
+    }
+
+    header.magic = BOOK_MAGIC;
+    header.version = BOOK_VERSION;
+    header.count = n;
+    if (fwrite(&header, sizeof(header), 1, out) != 1 ||
+        fwrite(table->slots, sizeof(BookEntry), n, out) != n) {
+        exitWithError("fwrite error");
+    }
+
+    if (fclose(out) != 0) {
+        exitWithError("fclose error");
+    }
+
+    if (rename(tmpPath, path) < 0) {
+        exitWithError("rename error");
+    }
+
+    printf("%llu book entries written to %s\n", (unsigned long long) n, path);
+}
+
+/*******************************************************************************
+* function name : main
+* input : int argc, char **argv
+* output : 0
+* explanation : bookgen -o book [-i old book] [-p plies] [records...]
+*               reads game records (stdin if none are given), adds the
+*               first plies moves of each game to the old book (if any)
+*               and writes the new book.
+*******************************************************************************/
+int main(int argc, char **argv) {
+    const char *outPath = NULL, *inPath = NULL;
+    int plies = DEFAULT_BOOK_PLIES;
+    BookTable table;
+    unsigned long games = 0, rejected = 0, unfinished = 0;
+    int opt, f;
+
+    while ((opt = getopt(argc, argv, "o:i:p:")) != -1) {
+        switch (opt) {
+            case 'o': outPath = optarg;
+                break;
+            case 'i': inPath = optarg;
+                break;
+            case 'p': plies = atoi(optarg);
+                break;
+            default: outPath = NULL;
+                break;
+        }
+    }
+
+    if (!outPath) {
+        fprintf(stderr, "usage: %s -o book [-i old book] [-p plies] [records...]\n",
+                argv[0]);
+        exit(-1);
+    }
+
+    table.capacity = INITIAL_SLOTS;
+    table.used = 0;
+    if (!(table.slots = calloc(table.capacity, sizeof(BookEntry)))) {
+        exitWithError("calloc error");
+    }
+
+    // extend an existing book
+    if (inPath) {
+        OpeningBook old;
+        uint64_t i;
+
+        if (bookOpen(&old, inPath) < 0) {
+            exitWithError("book open error");
+        }
+        for (i = 0; i < old.count; i++) {
+            addCounts(&table, &old.entries[i]);
+        }
+        bookClose(&old);
+    }
+
+    // no record files - read stdin
+    for (f = optind; f < argc || f == optind; f++) {
+        FILE *in = (f < argc) ? fopen(argv[f], "r") : stdin;
+        char line[MAX_LINE];
+
+        if (!in) {
+            exitWithError("fopen error");
+        }
+
+        while (fgets(line, sizeof(line), in)) {
+            int moves[MAX_PLIES];
+            int n = parseGame(line, moves);
+            int added;
+
+            if (n == 0) {
+                continue;
+            }
+
+            added = n < 0 ? -1 : addGame(&table, moves, n, plies);
+            if (added == -2) {
+                unfinished++;
+                continue;
+            }
+            if (added < 0) {
+                rejected++;
+                continue;
+            }
+            games++;
+        }
+
+        if (in != stdin) {
+            fclose(in);
+        }
+    }
+
+    printf("%lu games added, %lu rejected, %lu unfinished\n", games, rejected,
+           unfinished);
+    writeBook(&table, outPath);
+    free(table.slots);
+
+    return 0;
+}
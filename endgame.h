@@ -0,0 +1,449 @@
+/*
+ * Student name : Or Zipori
+ * Student : 302933833
+ * Course Exercise Group : 03
+ * Exercise Name : ex3
+ */
+#ifndef ENDGAME_H
+#define ENDGAME_H
+
+#include "othello.h"
+#include "timer.h"
+#include "tt.h"
+
+// from here on the solver plays the empties by parity, without the table
+#define ENDGAME_SHALLOW 6
+#define ENDGAME_INF 100
+// end game results live in the same table as the search, under other keys
+#define ENDGAME_KEY 0x5bd1e9955bd1e995ULL
+// head of the list of empty squares
+#define EMPTY_HEAD SQUARES
+
+/*
+ * state of one exact solve. the empty squares are kept in a linked list in
+ * the order they are worth trying, and parity has one bit per quadrant that
+ * has an odd number of empties.
+ */
+typedef struct {
+    int next[SQUARES + 1];
+    int prev[SQUARES + 1];
+    unsigned parity;
+    TransTable *tt;
+    uint64_t nodes;
+    long long deadline;
+    Boolean stop;
+} EndgameContext;
+
+// corners first, X squares (next to a corner on the diagonal) last
+static const int squareOrder[SQUARES] = {
+    0, 7, 56, 63,
+    2, 5, 16, 23, 40, 47, 58, 61,
+    3, 4, 24, 31, 32, 39, 59, 60,
+    18, 21, 42, 45,
+    19, 20, 26, 29, 34, 37, 43, 44,
+    27, 28, 35, 36,
+    10, 13, 17, 22, 41, 46, 50, 53,
+    11, 12, 25, 30, 33, 38, 51, 52,
+    1, 6, 8, 15, 48, 55, 57, 62,
+    9, 14, 49, 54
+};
+
+/*******************************************************************************
+* function name : quadrant
+* input : int sq
+* output : 0-3, the quarter of the board sq is in
+* explanation : -
+*******************************************************************************/
+static inline int quadrant(int sq) {
+    return ((sq / BOARD_SIZE) >= BOARD_SIZE / 2) * 2 +
+           ((sq % BOARD_SIZE) >= BOARD_SIZE / 2);
+}
+
+/*******************************************************************************
+* function name : endgameHash
+* input : Bitboard own, Bitboard opp
+* output : table key of the position, side to move is own
+* explanation : cheaper than keeping zobrist keys in the solver.
+*******************************************************************************/
+static inline uint64_t endgameHash(Bitboard own, Bitboard opp) {
+    uint64_t h = own * 0x9e3779b97f4a7c15ULL ^ (opp + ENDGAME_KEY) * 0xc2b2ae3d27d4eb4fULL;
+    h ^= h >> 31;
+    h *= 0x94d049bb133111ebULL;
+    return h ^ (h >> 29);
+}
+
+/*******************************************************************************
+* function name : endScore
+* input : Bitboard own, Bitboard opp
+* output : final disc difference for own
+* explanation : the empty squares go to the winner.
+*******************************************************************************/
+static inline int endScore(Bitboard own, Bitboard opp) {
+    int o = countDiscs(own), p = countDiscs(opp);
+    int empties = SQUARES - o - p;
+    int diff = o - p;
+
+    if (diff > 0) return diff + empties;
+    if (diff < 0) return diff - empties;
+    return 0;
+}
+
+/*******************************************************************************
+* function name : removeEmpty
+* input : EndgameContext *ctx, int sq
+* output : -
+* explanation : take sq out of the empty list, restoreEmpty puts it back.
+*              calls must be nested (last removed, first restored).
+*******************************************************************************/
+static inline void removeEmpty(EndgameContext *ctx, int sq) {
+    ctx->next[ctx->prev[sq]] = ctx->next[sq];
+    ctx->prev[ctx->next[sq]] = ctx->prev[sq];
+    ctx->parity ^= 1u << quadrant(sq);
+}
+
+static inline void restoreEmpty(EndgameContext *ctx, int sq) {
+    ctx->next[ctx->prev[sq]] = sq;
+    ctx->prev[ctx->next[sq]] = sq;
+    ctx->parity ^= 1u << quadrant(sq);
+}
+
+/*******************************************************************************
+* function name : solveLast1
+* input : Bitboard own, Bitboard opp, int sq
+* output : exact score for own
+* explanation : one empty square left - whoever can play it does.
+*******************************************************************************/
+static inline int solveLast1(Bitboard own, Bitboard opp, int sq) {
+    int diff = countDiscs(own) - countDiscs(opp);
+    Bitboard flips = computeFlips(own, opp, sq);
+
+    if (flips) {
+        return diff + 2 * countDiscs(flips) + 1;
+    }
+
+    flips = computeFlips(opp, own, sq);
+    if (flips) {
+        return diff - 2 * countDiscs(flips) - 1;
+    }
+
+    // nobody can play it, it goes to the winner
+    if (diff > 0) return diff + 1;
+    if (diff < 0) return diff - 1;
+    return 0;
+}
+
+/*******************************************************************************
+* function name : solveLast2
+* input : Bitboard own, Bitboard opp, int alpha, int beta, int sq1, int sq2,
+*         Boolean passed
+* output : exact score for own
+* explanation : two empty squares left.
+*******************************************************************************/
+static inline int solveLast2(Bitboard own, Bitboard opp, int alpha, int beta,
+                             int sq1, int sq2, Boolean passed) {
+    int best = -ENDGAME_INF;
+    Bitboard flips;
+
+    flips = computeFlips(own, opp, sq1);
+    if (flips) {
+        best = -solveLast1(opp & ~flips, own | flips | SQUARE_BIT(sq1), sq2);
+        if (best >= beta) {
+            return best;
+        }
+    }
+
+    flips = computeFlips(own, opp, sq2);
+    if (flips) {
+        int v = -solveLast1(opp & ~flips, own | flips | SQUARE_BIT(sq2), sq1);
+        if (v > best) {
+            best = v;
+        }
+    }
+
+    if (best != -ENDGAME_INF) {
+        return best;
+    }
+
+    // no move - pass, or the game is over
+    if (passed) {
+        return endScore(own, opp);
+    }
+    return -solveLast2(opp, own, -beta, -alpha, sq1, sq2, TRUE);
+}
+
+static int endgameSolve(EndgameContext *ctx, Bitboard own, Bitboard opp,
+                        int alpha, int beta, int empties, Boolean passed);
+
+/*******************************************************************************
+* function name : solveShallow
+* input : EndgameContext *ctx, Bitboard own, Bitboard opp, int alpha,
+*         int beta, int empties, Boolean passed
+* output : exact score for own
+* explanation : few empties - no move generation or table, the empties of
+*               the quadrants with an odd number of them are tried first.
+*******************************************************************************/
+static int solveShallow(EndgameContext *ctx, Bitboard own, Bitboard opp,
+                        int alpha, int beta, int empties, Boolean passed) {
+    int best = -ENDGAME_INF;
+    int round, sq;
+
+    if (empties == 2) {
+        int sq1 = ctx->next[EMPTY_HEAD];
+        return solveLast2(own, opp, alpha, beta, sq1, ctx->next[sq1], passed);
+    }
+
+    for (round = 0; round < 2; round++) {
+        for (sq = ctx->next[EMPTY_HEAD]; sq != EMPTY_HEAD; sq = ctx->next[sq]) {
+            Bitboard flips;
+            int odd = (ctx->parity >> quadrant(sq)) & 1;
+            int v;
+
+            if (odd != (round == 0)) {
+                continue;
+            }
+
+            flips = computeFlips(own, opp, sq);
+            if (!flips) {
+                continue;
+            }
+
+            removeEmpty(ctx, sq);
+            v = -endgameSolve(ctx, opp & ~flips, own | flips | SQUARE_BIT(sq),
+                              -beta, -alpha, empties - 1, FALSE);
+            restoreEmpty(ctx, sq);
+
+            if (v > best) {
+                best = v;
+                if (v > alpha) {
+                    alpha = v;
+                    if (alpha >= beta) {
+                        return best;
+                    }
+                }
+            }
+        }
+    }
+
+    if (best != -ENDGAME_INF) {
+        return best;
+    }
+
+    if (passed) {
+        return endScore(own, opp);
+    }
+    return -endgameSolve(ctx, opp, own, -beta, -alpha, empties, TRUE);
+}
+
+/*******************************************************************************
+* function name : sortEndgameMoves
+* input : EndgameContext *ctx, Bitboard own, Bitboard opp, Bitboard moves,
+*         int first, int list[]
+* output : number of moves in list
+* explanation : first (the table move) if legal, then fastest first - the
+*               moves leaving the opponent the fewest replies, corners
+*               preferred, odd quadrants preferred.
+*******************************************************************************/
+static inline int sortEndgameMoves(EndgameContext *ctx, Bitboard own,
+                                   Bitboard opp, Bitboard moves, int first,
+                                   int list[]) {
+    int keys[SQUARES];
+    int n = 0, i, j;
+
+    for (i = 0; i < SQUARES; i++) {
+        int sq = squareOrder[i];
+        Bitboard flips, nOwn, nOpp;
+        int key;
+
+        if (!(moves & SQUARE_BIT(sq))) {
+            continue;
+        }
+
+        flips = computeFlips(own, opp, sq);
+        nOwn = own | flips | SQUARE_BIT(sq);
+        nOpp = opp & ~flips;
+        key = 16 * countDiscs(generateMoves(nOpp, nOwn));
+        if (SQUARE_BIT(sq) & 0x8100000000000081ULL) key -= 24;
+        if ((ctx->parity >> quadrant(sq)) & 1) key -= 4;
+        if (sq == first) key = -1000;
+
+        // insertion sort, the lists are short
+        for (j = n; j > 0 && keys[j - 1] > key; j--) {
+            keys[j] = keys[j - 1];
+            list[j] = list[j - 1];
+        }
+        keys[j] = key;
+        list[j] = sq;
+        n++;
+    }
+
+    return n;
+}
+
+/*******************************************************************************
+* function name : endgameSolve
+* input : EndgameContext *ctx, Bitboard own, Bitboard opp, int alpha,
+*         int beta, int empties, Boolean passed
+* output : exact final disc difference for own (within alpha, beta)
+* explanation : principal variation search on the exact score. passed is
+*               TRUE if the opponent just passed.
+*******************************************************************************/
+static int endgameSolve(EndgameContext *ctx, Bitboard own, Bitboard opp,
+                        int alpha, int beta, int empties, Boolean passed) {
+    int alphaOrig = alpha;
+    int best = -ENDGAME_INF, bestMove = -1, ttMove = -1;
+    uint64_t key = 0;
+    Bitboard moves;
+    int list[SQUARES];
+    int n, i;
+
+    if ((++ctx->nodes & 4095) == 0 && nowNs() > ctx->deadline) {
+        ctx->stop = TRUE;
+    }
+
+    if (ctx->stop) {
+        return 0;
+    }
+
+    if (empties == 1) {
+        return solveLast1(own, opp, ctx->next[EMPTY_HEAD]);
+    }
+
+    if (empties <= ENDGAME_SHALLOW) {
+        return solveShallow(ctx, own, opp, alpha, beta, empties, passed);
+    }
+
+    moves = generateMoves(own, opp);
+    if (!moves) {
+        if (passed) {
+            return endScore(own, opp);
+        }
+        return -endgameSolve(ctx, opp, own, -beta, -alpha, empties, TRUE);
+    }
+
+    if (ctx->tt) {
+        TTData e;
+        key = endgameHash(own, opp);
+        if (ttProbe(ctx->tt, key, &e)) {
+            ttMove = (e.move == TT_NO_MOVE) ? -1 : e.move;
+            if (e.bound == TT_EXACT) return e.score;
+            if (e.bound == TT_LOWER && e.score > alpha) alpha = e.score;
+            if (e.bound == TT_UPPER && e.score < beta) beta = e.score;
+            if (alpha >= beta) return e.score;
+        }
+    }
+
+    n = sortEndgameMoves(ctx, own, opp, moves, ttMove, list);
+    for (i = 0; i < n; i++) {
+        int sq = list[i];
+        Bitboard flips = computeFlips(own, opp, sq);
+        Bitboard nOwn = opp & ~flips, nOpp = own | flips | SQUARE_BIT(sq);
+        int v;
+
+        removeEmpty(ctx, sq);
+        if (i == 0) {
+            v = -endgameSolve(ctx, nOwn, nOpp, -beta, -alpha, empties - 1, FALSE);
+        } else {
+            // prove the move is no better with a null window first
+            v = -endgameSolve(ctx, nOwn, nOpp, -alpha - 1, -alpha, empties - 1, FALSE);
+            if (v > alpha && v < beta) {
+                v = -endgameSolve(ctx, nOwn, nOpp, -beta, -v, empties - 1, FALSE);
+            }
+        }
+        restoreEmpty(ctx, sq);
+
+        if (v > best) {
+            best = v;
+            bestMove = sq;
+            if (v > alpha) {
+                alpha = v;
+                if (alpha >= beta) {
+                    break;
+                }
+            }
+        }
+    }
+
+    if (ctx->tt && !ctx->stop) {
+        int bound = (best <= alphaOrig) ? TT_UPPER :
+                    (best >= beta) ? TT_LOWER : TT_EXACT;
+        ttStore(ctx->tt, key, empties, bound, best, bestMove);
+    }
+
+    return best;
+}
+
+/*******************************************************************************
+* function name : solveEndgame
+* input : EndgameContext *ctx, const Position *pos, int timeMs, int *move,
+*         int *score
+* output : TRUE if solved, FALSE if the time ran out or there is no move
+* explanation : find the move with the best final disc difference for the
+*               side to move. ctx->tt must be set (or NULL) by the caller.
+*******************************************************************************/
+static Boolean solveEndgame(EndgameContext *ctx, const Position *pos, int timeMs,
+                            int *move, int *score) {
+    int player = pos->sideToMove;
+    Bitboard own = pos->discs[player], opp = pos->discs[OPPONENT(player)];
+    Bitboard empty = ~(own | opp);
+    int empties = countDiscs(empty);
+    int alpha = -ENDGAME_INF, beta = ENDGAME_INF;
+    int list[SQUARES];
+    int last = EMPTY_HEAD;
+    int n, i;
+
+    ctx->nodes = 0;
+    ctx->stop = FALSE;
+    ctx->deadline = nowNs() + (long long) timeMs * 1000000LL;
+    ctx->parity = 0;
+    *move = -1;
+
+    if (!pos->legalMoves) {
+        return FALSE;
+    }
+
+    // the empty squares in the order they are worth trying
+    for (i = 0; i < SQUARES; i++) {
+        int sq = squareOrder[i];
+        if (empty & SQUARE_BIT(sq)) {
+            ctx->next[last] = sq;
+            ctx->prev[sq] = last;
+            last = sq;
+            ctx->parity ^= 1u << quadrant(sq);
+        }
+    }
+    ctx->next[last] = EMPTY_HEAD;
+    ctx->prev[EMPTY_HEAD] = last;
+
+    n = sortEndgameMoves(ctx, own, opp, pos->legalMoves, -1, list);
+    for (i = 0; i < n; i++) {
+        int sq = list[i];
+        Bitboard flips = computeFlips(own, opp, sq);
+        Bitboard nOwn = opp & ~flips, nOpp = own | flips | SQUARE_BIT(sq);
+        int v;
+
+        removeEmpty(ctx, sq);
+        if (i == 0) {
+            v = -endgameSolve(ctx, nOwn, nOpp, -beta, -alpha, empties - 1, FALSE);
+        } else {
+            v = -endgameSolve(ctx, nOwn, nOpp, -alpha - 1, -alpha, empties - 1, FALSE);
+            if (v > alpha) {
+                v = -endgameSolve(ctx, nOwn, nOpp, -beta, -v, empties - 1, FALSE);
+            }
+        }
+        restoreEmpty(ctx, sq);
+
+        if (ctx->stop) {
+            return FALSE;
+        }
+
+        if (v > alpha) {
+            alpha = v;
+            *move = sq;
+        }
+    }
+
+    *score = alpha;
+    return TRUE;
+}
+
+#endif
@@ -0,0 +1,476 @@
+/*
+ * Student name : Or Zipori
+ * Student : 302933833
+ * Course Exercise Group : 03
+ * Exercise Name : ex3
+ */
+#ifndef EVAL_H
+#define EVAL_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include "othello.h"
+
+#define EVAL_MAGIC 0x3156454fu  // "OEV1"
+#define EVAL_VERSION 1
+// the game is split in stages by the number of discs, each has its weights
+#define EVAL_STAGES 4
+
+/*
+ * pattern evaluation. each pattern is a fixed set of squares, its weight
+ * table has one entry per way of filling them (3^squares, free/own/opp).
+ * every pattern is looked at in all the places it fits on the board - the
+ * board is flipped so that each place lands on the same squares, so one
+ * table serves all of them.
+ *
+ * the index of a pattern comes from the bitboards directly: the pattern's
+ * squares are gathered into a small number with shifts and masks (the same
+ * few instructions for the whole board, no loop over squares), and that
+ * number is turned into base 3 by a table.
+ */
+typedef enum {
+    P_EDGE_2X = 0, P_CORNER_3X3, P_LINE_2, P_LINE_3, P_LINE_4,
+    P_DIAG_8, P_DIAG_7, P_DIAG_6, P_DIAG_5, P_DIAG_4, PATTERNS
+} PatternType;
+
+// squares of each pattern where it is gathered, on the top left of the board
+static const Bitboard patternMask[PATTERNS] = {
+    0x00000000000042ffULL,  // top edge and its two X squares
+    0x0000000000070707ULL,  // 3x3 corner
+    0x000000000000ff00ULL,  // second row
+    0x0000000000ff0000ULL,  // third row
+    0x00000000ff000000ULL,  // fourth row
+    0x8040201008040201ULL,  // main diagonal
+    0x4020100804020100ULL,  // diagonals below it, 7 to 4 squares
+    0x2010080402010000ULL,
+    0x1008040201000000ULL,
+    0x0804020100000000ULL
+};
+
+static const int patternSquares[PATTERNS] = {10, 9, 8, 8, 8, 8, 7, 6, 5, 4};
+
+#define CORNER_SQUARES 0x8100000000000081ULL
+
+// the ways the board is flipped to bring a placement to the top left
+typedef enum {T_NONE = 0, T_H, T_V, T_HV, T_D, T_DH} BoardFlip;
+
+// the placements of each pattern (patternEvaluate follows this table)
+static const int placements[PATTERNS] = {4, 4, 4, 4, 4, 2, 4, 4, 4, 4};
+static const BoardFlip placementFlip[PATTERNS][4] = {
+    {T_NONE, T_V, T_D, T_DH},
+    {T_NONE, T_H, T_V, T_HV},
+    {T_NONE, T_V, T_D, T_DH},
+    {T_NONE, T_V, T_D, T_DH},
+    {T_NONE, T_V, T_D, T_DH},
+    {T_NONE, T_H, T_NONE, T_NONE},
+    {T_NONE, T_D, T_H, T_DH},
+    {T_NONE, T_D, T_H, T_DH},
+    {T_NONE, T_D, T_H, T_DH},
+    {T_NONE, T_D, T_H, T_DH}
+};
+
+typedef struct {
+    // offset of each pattern's table inside a stage
+    int offset[PATTERNS];
+    int stageSize;
+    // weights[stage * stageSize + offset[pattern] + index]
+    int16_t *weights;
+    int16_t mobility[EVAL_STAGES];
+    int16_t parity[EVAL_STAGES];
+    Boolean ready;
+} EvalWeights;
+
+typedef struct {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t stages;
+    uint32_t stageSize;
+} EvalHeader;
+
+static EvalWeights evalWeights;
+// binary to ternary, bit k becomes 3^k
+static uint16_t binToTernary[1 << 10];
+
+/*******************************************************************************
+* function name : flipVertical, mirrorHorizontal, flipDiagonal
+* input : Bitboard b
+* output : b flipped upside down / left to right / over the main diagonal
+* explanation : -
+*******************************************************************************/
+static inline Bitboard flipVertical(Bitboard b) {
+    return __builtin_bswap64(b);
+}
+
+static inline Bitboard mirrorHorizontal(Bitboard b) {
+    b = ((b >> 1) & 0x5555555555555555ULL) | ((b & 0x5555555555555555ULL) << 1);
+    b = ((b >> 2) & 0x3333333333333333ULL) | ((b & 0x3333333333333333ULL) << 2);
+    b = ((b >> 4) & 0x0f0f0f0f0f0f0f0fULL) | ((b & 0x0f0f0f0f0f0f0f0fULL) << 4);
+    return b;
+}
+
+static inline Bitboard flipDiagonal(Bitboard b) {
+    Bitboard t;
+    t = 0x0f0f0f0f00000000ULL & (b ^ (b << 28));
+    b ^= t ^ (t >> 28);
+    t = 0x3333000033330000ULL & (b ^ (b << 14));
+    b ^= t ^ (t >> 14);
+    t = 0x5500550055005500ULL & (b ^ (b << 7));
+    b ^= t ^ (t >> 7);
+    return b;
+}
+
+/*******************************************************************************
+* function name : flipBoard
+* input : Bitboard b, BoardFlip f
+* output : b flipped by f
+* explanation : -
+*******************************************************************************/
+static inline Bitboard flipBoard(Bitboard b, BoardFlip f) {
+    switch (f) {
+        case T_H: return mirrorHorizontal(b);
+        case T_V: return flipVertical(b);
+        case T_HV: return flipVertical(mirrorHorizontal(b));
+        case T_D: return flipDiagonal(b);
+        case T_DH: return flipDiagonal(mirrorHorizontal(b));
+        default: return b;
+    }
+}
+
+/*
+ * gather the squares of a pattern (top left placement) into the low bits,
+ * lowest square first.
+ */
+static inline unsigned gatherEdge2X(Bitboard b) {
+    return (unsigned) ((b & 0xff) | ((b >> 1) & 0x100) | ((b >> 5) & 0x200));
+}
+
+static inline unsigned gatherCorner(Bitboard b) {
+    return (unsigned) ((b & 0x7) | ((b >> 5) & 0x38) | ((b >> 10) & 0x1c0));
+}
+
+static inline unsigned gatherRow(Bitboard b, int row) {
+    return (unsigned) ((b >> (row * BOARD_SIZE)) & 0xff);
+}
+
+// every square of a diagonal is in another column - one multiply brings
+// them all to the top byte
+static inline unsigned gatherDiagonal(Bitboard b, int pattern) {
+    return (unsigned) (((b & patternMask[pattern]) * 0x0101010101010101ULL) >> 56);
+}
+
+/*******************************************************************************
+* function name : patternIndex
+* input : unsigned own, unsigned opp
+* output : index of the filling in the pattern's table
+* explanation : own is 1, opp is 2 in base 3.
+*******************************************************************************/
+static inline int patternIndex(unsigned own, unsigned opp) {
+    return binToTernary[own] + 2 * binToTernary[opp];
+}
+
+/*******************************************************************************
+* function name : evalStage
+* input : int discs - discs on the board
+* output : the stage of the game
+* explanation : -
+*******************************************************************************/
+static inline int evalStage(int discs) {
+    int stage = (discs - 4) / 15;
+    return (stage >= EVAL_STAGES) ? EVAL_STAGES - 1 : stage;
+}
+
+/*******************************************************************************
+* function name : evaluateBoard
+* input : Bitboard o, Bitboard p - discs of the side to move and of the
+*         opponent, Bitboard moves - the legal moves of o
+* output : score for the side to move
+* explanation : sum of the weights of every pattern placement, mobility and
+*               parity of the empty squares.
+*******************************************************************************/
+static inline int evaluateBoard(Bitboard o, Bitboard p, Bitboard moves) {
+    const EvalWeights *ew = &evalWeights;
+    int discs = countDiscs(o | p);
+    int stage = evalStage(discs);
+    const int16_t *w = ew->weights + stage * ew->stageSize;
+    // the board seen from each of the places a pattern may be
+    Bitboard oH = mirrorHorizontal(o), pH = mirrorHorizontal(p);
+    Bitboard oV = flipVertical(o), pV = flipVertical(p);
+    Bitboard oHV = flipVertical(oH), pHV = flipVertical(pH);
+    Bitboard oD = flipDiagonal(o), pD = flipDiagonal(p);
+    Bitboard oDH = flipDiagonal(oH), pDH = flipDiagonal(pH);
+    const int16_t *t;
+    int empties = SQUARES - discs;
+    int score = 0;
+    int r, d;
+
+    t = w + ew->offset[P_EDGE_2X];
+    score += t[patternIndex(gatherEdge2X(o), gatherEdge2X(p))];
+    score += t[patternIndex(gatherEdge2X(oV), gatherEdge2X(pV))];
+    score += t[patternIndex(gatherEdge2X(oD), gatherEdge2X(pD))];
+    score += t[patternIndex(gatherEdge2X(oDH), gatherEdge2X(pDH))];
+
+    t = w + ew->offset[P_CORNER_3X3];
+    score += t[patternIndex(gatherCorner(o), gatherCorner(p))];
+    score += t[patternIndex(gatherCorner(oH), gatherCorner(pH))];
+    score += t[patternIndex(gatherCorner(oV), gatherCorner(pV))];
+    score += t[patternIndex(gatherCorner(oHV), gatherCorner(pHV))];
+
+    for (r = 1; r <= 3; r++) {
+        t = w + ew->offset[P_LINE_2 + r - 1];
+        score += t[patternIndex(gatherRow(o, r), gatherRow(p, r))];
+        score += t[patternIndex(gatherRow(oV, r), gatherRow(pV, r))];
+        score += t[patternIndex(gatherRow(oD, r), gatherRow(pD, r))];
+        score += t[patternIndex(gatherRow(oDH, r), gatherRow(pDH, r))];
+    }
+
+    t = w + ew->offset[P_DIAG_8];
+    score += t[patternIndex(gatherDiagonal(o, P_DIAG_8), gatherDiagonal(p, P_DIAG_8))];
+    score += t[patternIndex(gatherDiagonal(oH, P_DIAG_8), gatherDiagonal(pH, P_DIAG_8))];
+
+    for (d = P_DIAG_7; d <= P_DIAG_4; d++) {
+        t = w + ew->offset[d];
+        score += t[patternIndex(gatherDiagonal(o, d), gatherDiagonal(p, d))];
+        score += t[patternIndex(gatherDiagonal(oD, d), gatherDiagonal(pD, d))];
+        score += t[patternIndex(gatherDiagonal(oH, d), gatherDiagonal(pH, d))];
+        score += t[patternIndex(gatherDiagonal(oDH, d), gatherDiagonal(pDH, d))];
+    }
+
+    score += ew->mobility[stage] *
+             (countDiscs(moves) - countDiscs(generateMoves(p, o)));
+    score += ew->parity[stage] * ((empties & 1) ? 1 : -1);
+
+    return score;
+}
+
+/*******************************************************************************
+* function name : patternEvaluate
+* input : const Position *pos
+* output : score for the side to move
+* explanation : evaluateBoard of the position.
+*******************************************************************************/
+static inline int patternEvaluate(const Position *pos) {
+    int player = pos->sideToMove;
+    return evaluateBoard(pos->discs[player], pos->discs[OPPONENT(player)],
+                         pos->legalMoves);
+}
+
+/*******************************************************************************
+* function name : evalLayout
+* input : EvalWeights *ew
+* output : -
+* explanation : the tables and ternary conversion, no weights yet.
+*******************************************************************************/
+static inline void evalLayout(EvalWeights *ew) {
+    int i, k, size = 0;
+
+    for (i = 0; i < PATTERNS; i++) {
+        int entries = 1;
+        for (k = 0; k < patternSquares[i]; k++) {
+            entries *= 3;
+        }
+        ew->offset[i] = size;
+        size += entries;
+    }
+    ew->stageSize = size;
+
+    for (i = 0; i < (1 << 10); i++) {
+        int t = 0, power = 1;
+        for (k = 0; k < 10; k++) {
+            if (i & (1 << k)) {
+                t += power;
+            }
+            power *= 3;
+        }
+        binToTernary[i] = (uint16_t) t;
+    }
+}
+
+/*******************************************************************************
+* function name : defaultPatternWeight
+* input : int pattern, int index, const int cover[]
+* output : weight of one filling of a pattern
+* explanation : corners spread over the patterns that cover them, discs in a
+*               run from an owned corner along the edge (they can't be
+*               flipped any more), and the C and X squares next to a free
+*               corner count against their owner.
+*******************************************************************************/
+static inline int defaultPatternWeight(int pattern, int index, const int cover[]) {
+    Bitboard mask = patternMask[pattern];
+    int state[SQUARES] = {0};
+    int weight = 0;
+    int sq, side, x;
+
+    // the index digits follow the squares of the mask from the lowest
+    for (sq = 0; sq < SQUARES; sq++) {
+        if (mask & SQUARE_BIT(sq)) {
+            int digit = index % 3;
+            state[sq] = (digit == 2) ? -1 : digit;
+            index /= 3;
+        }
+    }
+
+    for (sq = 0; sq < SQUARES; sq++) {
+        if ((CORNER_SQUARES & SQUARE_BIT(sq)) && cover[sq]) {
+            weight += 160 * state[sq] / cover[sq];
+        }
+    }
+
+    if (pattern == P_EDGE_2X) {
+        for (side = 0; side < 2; side++) {
+            int corner = side ? BOARD_SIZE - 1 : 0, step = side ? -1 : 1;
+
+            if (state[corner] == 0) {
+                weight -= 16 * state[corner + step];
+                continue;
+            }
+
+            for (x = corner; x >= 0 && x < BOARD_SIZE && state[x] == state[corner];
+                 x += step) {
+                weight += 16 * state[x];
+            }
+        }
+    }
+
+    if (pattern == P_CORNER_3X3 && state[SQUARE(0, 0)] == 0) {
+        weight -= 64 * state[SQUARE(1, 1)];
+    }
+
+    return weight;
+}
+
+/*******************************************************************************
+* function name : evalDefault
+* input : -
+* output : 0 on success, -1 if the memory could not be allocated
+* explanation : hand made weights, used when there is no weights file.
+*******************************************************************************/
+static inline int evalDefault() {
+    EvalWeights *ew = &evalWeights;
+    // number of pattern placements covering each square
+    int cover[SQUARES] = {0};
+    int i, j, s, sq, index;
+
+    evalLayout(ew);
+    free(ew->weights);
+    ew->weights = malloc(sizeof(int16_t) * EVAL_STAGES * ew->stageSize);
+    if (!ew->weights) {
+        return -1;
+    }
+
+    for (i = 0; i < PATTERNS; i++) {
+        for (j = 0; j < placements[i]; j++) {
+            for (sq = 0; sq < SQUARES; sq++) {
+                if (flipBoard(SQUARE_BIT(sq), placementFlip[i][j]) & patternMask[i]) {
+                    cover[sq]++;
+                }
+            }
+        }
+    }
+
+    for (i = 0; i < PATTERNS; i++) {
+        int entries = (i + 1 < PATTERNS ? ew->offset[i + 1] : ew->stageSize) -
+                      ew->offset[i];
+        for (index = 0; index < entries; index++) {
+            int16_t weight = (int16_t) defaultPatternWeight(i, index, cover);
+            for (s = 0; s < EVAL_STAGES; s++) {
+                ew->weights[s * ew->stageSize + ew->offset[i] + index] = weight;
+            }
+        }
+    }
+
+    for (s = 0; s < EVAL_STAGES; s++) {
+        ew->mobility[s] = 32;
+        ew->parity[s] = (s == EVAL_STAGES - 1) ? 8 : 0;
+    }
+
+    ew->ready = TRUE;
+    return 0;
+}
+
+/*******************************************************************************
+* function name : evalLoad
+* input : const char *path
+* output : 0 on success, -1 on failure
+* explanation : the file is an EvalHeader, the weights of every stage and
+*               then the mobility and parity weights of every stage.
+*******************************************************************************/
+static inline int evalLoad(const char *path) {
+    EvalWeights *ew = &evalWeights;
+    size_t count;
+    EvalHeader header;
+    FILE *in;
+
+    evalLayout(ew);
+    if (!(in = fopen(path, "rb"))) {
+        return -1;
+    }
+
+    count = (size_t) EVAL_STAGES * ew->stageSize;
+    free(ew->weights);
+    ew->weights = malloc(sizeof(int16_t) * count);
+    if (!ew->weights ||
+        fread(&header, sizeof(header), 1, in) != 1 ||
+        header.magic != EVAL_MAGIC || header.version != EVAL_VERSION ||
+        header.stages != EVAL_STAGES || header.stageSize != (uint32_t) ew->stageSize ||
+        fread(ew->weights, sizeof(int16_t), count, in) != count ||
+        fread(ew->mobility, sizeof(int16_t), EVAL_STAGES, in) != EVAL_STAGES ||
+        fread(ew->parity, sizeof(int16_t), EVAL_STAGES, in) != EVAL_STAGES) {
+        free(ew->weights);
+        ew->weights = NULL;
+        fclose(in);
+        return -1;
+    }
+
+    fclose(in);
+    ew->ready = TRUE;
+    return 0;
+}
+
+/*******************************************************************************
+* function name : evalFree
+* input : -
+* output : -
+* explanation : -
+*******************************************************************************/
+static inline void evalFree() {
+    free(evalWeights.weights);
+    evalWeights.weights = NULL;
+    evalWeights.ready = FALSE;
+}
+
+/*******************************************************************************
+* function name : evalSave
+* input : const char *path
+* output : 0 on success, -1 on failure
+* explanation : write the weights in the format evalLoad reads.
+*******************************************************************************/
+static inline int evalSave(const char *path) {
+    const EvalWeights *ew = &evalWeights;
+    size_t count = (size_t) EVAL_STAGES * ew->stageSize;
+    EvalHeader header;
+    FILE *out;
+    int failed;
+
+    if (!(out = fopen(path, "wb"))) {
+        return -1;
+    }
+
+    header.magic = EVAL_MAGIC;
+    header.version = EVAL_VERSION;
+    header.stages = EVAL_STAGES;
+    header.stageSize = ew->stageSize;
+    failed = fwrite(&header, sizeof(header), 1, out) != 1 ||
+             fwrite(ew->weights, sizeof(int16_t), count, out) != count ||
+             fwrite(ew->mobility, sizeof(int16_t), EVAL_STAGES, out) != EVAL_STAGES ||
+             fwrite(ew->parity, sizeof(int16_t), EVAL_STAGES, out) != EVAL_STAGES;
+
+    if (fclose(out) != 0 || failed) {
+        return -1;
+    }
+
+    return 0;
+}
+
+#endif
@@ -0,0 +1,145 @@
+/*
+ * Student name : Or Zipori
+ * Student : 302933833
+ * Course Exercise Group : 03
+ * Exercise Name : ex3
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include "othello.h"
+#include "eval.h"
+#include "timer.h"
+
+#define DEFAULT_POSITIONS 100000
+#define DEFAULT_ROUNDS 20
+
+/*
+ * what the evaluation reads of a position. a whole Position is kilobytes
+ * of undo stack, so many of them would time the cache and not evaluateBoard.
+ */
+typedef struct {
+    Bitboard own;
+    Bitboard opp;
+    Bitboard moves;
+} BenchPosition;
+
+/*******************************************************************************
+* function name : exitWithError
+* input : message
+* output : -
+* explanation : write to stderr the message and exit with code -1
+*******************************************************************************/
+void exitWithError(char *msg) {
+    perror(msg);
+    exit(-1);
+}
+
+/*******************************************************************************
+* function name : randomPosition
+* input : BenchPosition *out, uint64_t *state
+* output : -
+* explanation : a random number of random moves from the opening, so the
+*               positions come from every stage of the game.
+*******************************************************************************/
+void randomPosition(BenchPosition *out, uint64_t *state) {
+    static Position pos;
+    int plies = splitMix64(state) % 58;
+
+    initPosition(&pos);
+    while (pos.ply < plies) {
+        Bitboard moves = pos.legalMoves;
+        int k;
+
+        if (!moves) {
+            if (!mustPass(&pos)) {
+                break;
+            }
+            makePass(&pos);
+            continue;
+        }
+
+        for (k = splitMix64(state) % countDiscs(moves); k > 0; k--) {
+            moves &= moves - 1;
+        }
+        makeMove(&pos, __builtin_ctzll(moves));
+    }
+
+    out->own = pos.discs[pos.sideToMove];
+    out->opp = pos.discs[OPPONENT(pos.sideToMove)];
+    out->moves = pos.legalMoves;
+}
+
+/*******************************************************************************
+* function name : main
+* input : int argc, char **argv
+* output : 0
+* explanation : evalbench [-n positions] [-r rounds] [-w weights] [-o out]
+*               evaluates random positions over and over and prints the
+*               evaluations per second. -o writes the weights in use.
+*******************************************************************************/
+int main(int argc, char **argv) {
+    int positions = DEFAULT_POSITIONS, rounds = DEFAULT_ROUNDS;
+    const char *weightsPath = NULL, *outPath = NULL;
+    uint64_t state = 1;
+    BenchPosition *pos;
+    long long start;
+    double seconds;
+    // keeps the compiler from dropping the evaluations
+    long long sum = 0;
+    int opt, i, r;
+
+    while ((opt = getopt(argc, argv, "n:r:w:o:")) != -1) {
+        switch (opt) {
+            case 'n': positions = atoi(optarg);
+                break;
+            case 'r': rounds = atoi(optarg);
+                break;
+            case 'w': weightsPath = optarg;
+                break;
+            case 'o': outPath = optarg;
+                break;
+            default:
+                fprintf(stderr, "usage: %s [-n positions] [-r rounds] "
+                        "[-w weights] [-o out]\n", argv[0]);
+                exit(-1);
+        }
+    }
+
+    if (positions < 1) positions = 1;
+    if (rounds < 1) rounds = 1;
+
+    if (weightsPath ? evalLoad(weightsPath) < 0 : evalDefault() < 0) {
+        exitWithError("weights error");
+    }
+
+    if (outPath) {
+        if (evalSave(outPath) < 0) {
+            exitWithError("weights save error");
+        }
+        printf("weights written to %s\n", outPath);
+    }
+
+    if (!(pos = malloc(sizeof(BenchPosition) * positions))) {
+        exitWithError("malloc error");
+    }
+    for (i = 0; i < positions; i++) {
+        randomPosition(&pos[i], &state);
+    }
+
+    start = nowNs();
+    for (r = 0; r < rounds; r++) {
+        for (i = 0; i < positions; i++) {
+            sum += evaluateBoard(pos[i].own, pos[i].opp, pos[i].moves);
+        }
+    }
+    seconds = (nowNs() - start) / 1e9;
+
+    printf("%lld evaluations in %.3f seconds, %.0f evaluations/sec "
+           "(checksum %lld)\n", (long long) positions * rounds, seconds,
+           seconds > 0 ? (double) positions * rounds / seconds : 0.0, sum);
+
+    free(pos);
+    evalFree();
+    return 0;
+}
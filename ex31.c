@@ -4,16 +4,26 @@
  * Course Exercise Group : 03
  * Exercise Name : ex3
  */
+// accept4 and struct ucred
+#define _GNU_SOURCE
 #include <stdio.h>
 #include <stdlib.h>
 #include <unistd.h>
 #include <sys/types.h>
 #include <sys/stat.h>
-#include <sys/ipc.h>
-#include <sys/shm.h>
+#include <sys/mman.h>
 #include <sys/fcntl.h>
 #include <string.h>
 #include <signal.h>
+#include <errno.h>
+#include <pthread.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include "ipc.h"
+#include "archive.h"
+#include "timer.h"
 
 #define BOARD_SIZE 8
 #define BLACK 2
@@ -28,6 +38,50 @@ typedef struct {
     int y;
 } Point;
 
+#define MAX_EVENTS 64
+// the arena on huge pages is a whole number of them
+#define HUGE_PAGE (2 * 1024 * 1024)
+
+// a connected player waiting for an opponent
+typedef struct {
+    int fd;
+    pid_t pid;
+} Waiting;
+
+/*
+ * the server's state, shared by its threads. in single game mode (the
+ * default) the server hosts one game and exits when it ends, with -g it
+ * hosts up to slots games at once until it is stopped.
+ */
+typedef struct {
+    GameArena *arena;
+    // the memory of the arena, its fd goes to every player
+    int shmFD;
+    size_t size;
+    // put the arena on huge pages
+    Boolean huge;
+    uint32_t slots;
+    Boolean single;
+    // games over so far, only the reaper thread writes it
+    unsigned long finished;
+    // the reaper raises it when a slot is freed, it wakes epoll_wait
+    int freedFD;
+    // the connection of each player in a game, 2 per slot (black, white),
+    // -1 for none. it closes when the player exits
+    int *playerFD;
+    // players waiting for a game, in the order they connected
+    Waiting *waiting;
+    int waitingCount;
+    int waitingCapacity;
+    // every finished game is added to the archive if there is one
+    Boolean archiving;
+    ArchiveWriter archive;
+    // when the game of each slot started, in milliseconds since the epoch
+    uint64_t *startMs;
+    // print the latency histograms when the server exits
+    Boolean latencyAtExit;
+} Server;
+
 /*******************************************************************************
 * function name : exitWithError
 * input : message
@@ -39,101 +93,690 @@ void exitWithError(char *msg) {
     exit(-1);
 }
 
+/*******************************************************************************
+* function name : resultName
+* input : uint32_t result
+* output : the result as it is printed
+* explanation : -
+*******************************************************************************/
+const char *resultName(uint32_t result) {
+    if (result == WHITE_WIN) return "Winning player: White";
+    if (result == BLACK_WIN) return "Winning player: Black";
+    if (result == DRAW) return "No winning player";
+    return "No result";
+}
+
+/*******************************************************************************
+* function name : movesText
+* input : SharedGame *game, char *text
+* output : number of moves of the game so far
+* explanation : the moves as squares, "f5d6c3...", "--" for a pass. text
+*               must hold 4 * RING_SIZE + 1 chars.
+*******************************************************************************/
+int movesText(SharedGame *game, char *text) {
+    MoveEntry moves[2 * RING_SIZE];
+    int n = gameHistory(game, moves), i;
+
+    for (i = 0; i < n; i++) {
+        if (moves[i].square == SQUARE_NONE) {
+            text[2 * i] = '-';
+            text[2 * i + 1] = '-';
+        } else {
+            text[2 * i] = 'a' + moves[i].square % BOARD_SIZE;
+            text[2 * i + 1] = '1' + moves[i].square / BOARD_SIZE;
+        }
+    }
+    text[2 * n] = '\0';
+
+    return n;
+}
+
+/*******************************************************************************
+* function name : archiveGameOver
+* input : Server *server, uint32_t slot
+* output : -
+* explanation : add the finished game of slot to the archive. a game that
+*               can't be added is reported, the server goes on.
+*******************************************************************************/
+void archiveGameOver(Server *server, uint32_t slot) {
+    SharedGame *game = arenaSlot(server->arena, slot);
+    MoveEntry history[2 * RING_SIZE];
+    uint8_t moves[2 * RING_SIZE];
+    uint64_t now = wallMs();
+    uint32_t result = loadWord(&game->result);
+    int n = gameHistory(game, history), i;
+
+    // a game a player died in has no result to keep
+    if (result != BLACK_WIN && result != WHITE_WIN && result != DRAW) {
+        return;
+    }
+
+    for (i = 0; i < n; i++) {
+        moves[i] = history[i].square == SQUARE_NONE ? ARCHIVE_PASS :
+                   history[i].square;
+    }
+
+    if (archiveAppend(&server->archive, moves, n, result, server->startMs[slot],
+                      (uint32_t) (now - server->startMs[slot])) < 0) {
+        perror("archive error");
+    }
+}
+
+/*******************************************************************************
+* function name : reaper
+* input : void *arg - the Server
+* output : NULL
+* explanation : report every finished game and recycle its slot. in single
+*               game mode it returns after the first game.
+*******************************************************************************/
+void *reaper(void *arg) {
+    Server *server = (Server *) arg;
+    GameArena *arena = server->arena;
+
+    while (TRUE) {
+        // a game finished after this read changes the counter
+        uint32_t events = loadWord(&arena->finishedEvents);
+        uint32_t slot;
+
+        while ((slot = listPop(arena, &arena->finishedList)) != SLOT_NONE) {
+            SharedGame *game = arenaSlot(arena, slot);
+            char text[4 * RING_SIZE + 1];
+            int n;
+
+            latencyAdd(&arena->latency[LATENCY_REAP], nowNs() - game->endedNs);
+            n = movesText(game, text);
+
+            if (server->single) {
+                printf("GAME OVER !\n");
+                printf("%s\n", resultName(loadWord(&game->result)));
+            } else {
+                // the moves line is a game record bookgen reads
+                printf("Game %u (slot %u) over after %d moves: %s\n%s\n",
+                       game->gameNumber, slot, n,
+                       resultName(loadWord(&game->result)), text);
+            }
+            fflush(stdout);
+
+            if (server->archiving) {
+                archiveGameOver(server, slot);
+            }
+
+            arenaFree(arena, slot);
+            server->finished++;
+            if (eventfd_write(server->freedFD, 1) < 0) {
+                perror("eventfd_write error");
+            }
+            if (server->single) {
+                return NULL;
+            }
+        }
+
+        futexWait(&arena->finishedEvents, events);
+    }
+}
+
+/*******************************************************************************
+* function name : printLatency
+* input : Server *server
+* output : -
+* explanation : the latency histograms of all the games so far. the players
+*               add theirs when they leave a game.
+*******************************************************************************/
+void printLatency(Server *server) {
+    int stage;
+
+    printf("latency of the games so far:\n");
+    for (stage = 0; stage < LATENCY_STAGES; stage++) {
+        latencyPrint(stdout, latencyStageName(stage), &server->arena->latency[stage]);
+    }
+    fflush(stdout);
+}
+
+/*******************************************************************************
+* function name : printStatus
+* input : Server *server
+* output : -
+* explanation : how many slots are in each state, and every game being
+*               played, and the latencies.
+*******************************************************************************/
+void printStatus(Server *server) {
+    GameArena *arena = server->arena;
+    uint32_t slot, starting = 0, playing = 0, over = 0, free = 0;
+
+    printf("slot status:\n");
+    for (slot = 0; slot < server->slots; slot++) {
+        SharedGame *game = arenaSlot(arena, slot);
+        char text[4 * RING_SIZE + 1];
+        const char *state;
+
+        if (loadWord(&game->slotState) == SLOT_FREE) {
+            free++;
+            continue;
+        }
+
+        if (loadWord(&game->attached) < 2) {
+            state = "starting";
+            starting++;
+        } else if (loadWord(&game->result) == 0) {
+            state = "playing";
+            playing++;
+        } else {
+            state = "over";
+            over++;
+        }
+
+        printf("  slot %u: game %u, black %u, white %u, %s, moves %d %s\n", slot,
+               game->gameNumber, game->blackPid, game->whitePid, state,
+               movesText(game, text), text);
+    }
+
+    printf("%u slots: %u free, %u starting, %u playing, %u over; "
+           "%u games started, %lu finished\n", server->slots, free, starting,
+           playing, over, loadWord(&arena->games), server->finished);
+    printLatency(server);
+}
+
+/*******************************************************************************
+* function name : signalThread
+* input : void *arg - the Server
+* output : NULL
+* explanation : SIGUSR2 prints the slot status, SIGINT and SIGTERM remove
+*               the socket and end the server.
+*******************************************************************************/
+void *signalThread(void *arg) {
+    Server *server = (Server *) arg;
+    sigset_t set;
+    int sig;
+
+    sigemptyset(&set);
+    sigaddset(&set, SIGUSR2);
+    sigaddset(&set, SIGINT);
+    sigaddset(&set, SIGTERM);
+
+    while (TRUE) {
+        if (sigwait(&set, &sig) != 0) {
+            continue;
+        }
+
+        if (sig == SIGUSR2) {
+            printStatus(server);
+            continue;
+        }
+
+        // the shared memory has no name, it goes with the last process
+        unlink(SERVER_SOCKET);
+        if (server->latencyAtExit) {
+            printLatency(server);
+        }
+        exit(0);
+    }
+}
+
+/*******************************************************************************
+* function name : createArena
+* input : Server *server
+* output : -
+* explanation : create and map the shared memory of server->slots games.
+*               the name of the segment is removed as soon as it is open -
+*               the players get the fd itself - so a server that dies
+*               leaves nothing behind. with server->huge the arena is a
+*               memfd on huge pages, falling back to normal pages if the
+*               system has none to give.
+*******************************************************************************/
+void createArena(Server *server) {
+    char name[64];
+
+    server->size = arenaSize(server->slots);
+    server->shmFD = -1;
+
+    if (server->huge) {
+        server->size = (server->size + HUGE_PAGE - 1) & ~(size_t) (HUGE_PAGE - 1);
+        server->shmFD = memfd_create("ex31-arena", MFD_HUGETLB | MFD_CLOEXEC);
+        if (server->shmFD >= 0 && ftruncate(server->shmFD, server->size) < 0) {
+            close(server->shmFD);
+            server->shmFD = -1;
+        }
+
+        if (server->shmFD >= 0) {
+            server->arena = mmap(NULL, server->size, PROT_READ | PROT_WRITE,
+                                 MAP_SHARED | MAP_POPULATE, server->shmFD, 0);
+            if (server->arena == MAP_FAILED) {
+                close(server->shmFD);
+                server->shmFD = -1;
+            }
+        }
+
+        if (server->shmFD < 0) {
+            perror("huge pages error, using normal pages");
+            server->size = arenaSize(server->slots);
+        }
+    }
+
+    if (server->shmFD < 0) {
+        // unique to this server
+        snprintf(name, sizeof(name), "/ex31.%d", (int) getpid());
+        if ((server->shmFD = shm_open(name, O_RDWR | O_CREAT | O_EXCL, 0600)) < 0) {
+            exitWithError("shm_open error");
+        }
+        shm_unlink(name);
+
+        if (ftruncate(server->shmFD, server->size) < 0) {
+            exitWithError("ftruncate error");
+        }
+
+        server->arena = mmap(NULL, server->size, PROT_READ | PROT_WRITE,
+                             MAP_SHARED, server->shmFD, 0);
+        if (server->arena == MAP_FAILED) {
+            exitWithError("mmap error");
+        }
+    }
+
+    // the new memory is zero
+    arenaInit(server->arena, server->slots);
+}
+
+/*******************************************************************************
+* function name : listenSocket
+* input : -
+* output : the listening socket of the server
+* explanation : a socket left by a server that died is removed first.
+*******************************************************************************/
+int listenSocket() {
+    struct sockaddr_un addr;
+    int fd;
+
+    if ((fd = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0)) < 0) {
+        exitWithError("socket error");
+    }
+
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    strncpy(addr.sun_path, SERVER_SOCKET, sizeof(addr.sun_path) - 1);
+    unlink(SERVER_SOCKET);
+
+    if (bind(fd, (struct sockaddr *) &addr, sizeof(addr)) < 0) {
+        exitWithError("bind error");
+    }
+
+    if (listen(fd, SOMAXCONN) < 0) {
+        exitWithError("listen error");
+    }
+
+    return fd;
+}
+
+/*******************************************************************************
+* function name : acceptPlayers
+* input : Server *server, int listenFD, int epollFD
+* output : -
+* explanation : accept every pending connection. the kernel tells who the
+*               player is - only processes of our user may play, the shared
+*               memory is writable by us only anyway.
+*******************************************************************************/
+void acceptPlayers(Server *server, int listenFD, int epollFD) {
+    struct epoll_event ev;
+    struct ucred cred;
+    socklen_t len;
+    int fd;
+
+    while ((fd = accept4(listenFD, NULL, NULL, SOCK_NONBLOCK | SOCK_CLOEXEC)) >= 0) {
+        len = sizeof(cred);
+        if (getsockopt(fd, SOL_SOCKET, SO_PEERCRED, &cred, &len) < 0 ||
+            cred.uid != getuid()) {
+            close(fd);
+            continue;
+        }
+
+        if (server->waitingCount == server->waitingCapacity) {
+            server->waitingCapacity = server->waitingCapacity ? 2 * server->waitingCapacity : 64;
+            server->waiting = realloc(server->waiting,
+                                      server->waitingCapacity * sizeof(Waiting));
+            if (!server->waiting) {
+                exitWithError("realloc error");
+            }
+        }
+
+        // watch for the player giving up before it is paired
+        ev.events = EPOLLRDHUP;
+        ev.data.fd = fd;
+        if (epoll_ctl(epollFD, EPOLL_CTL_ADD, fd, &ev) < 0) {
+            exitWithError("epoll_ctl error");
+        }
+
+        server->waiting[server->waitingCount].fd = fd;
+        server->waiting[server->waitingCount].pid = cred.pid;
+        server->waitingCount++;
+    }
+
+    if (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR &&
+        errno != ECONNABORTED) {
+        exitWithError("accept error");
+    }
+}
+
+/*******************************************************************************
+* function name : dropPlayer
+* input : Server *server, int fd
+* output : -
+* explanation : a waiting player hung up, forget it.
+*******************************************************************************/
+void dropPlayer(Server *server, int fd) {
+    int i;
+
+    for (i = 0; i < server->waitingCount; i++) {
+        if (server->waiting[i].fd == fd) {
+            memmove(&server->waiting[i], &server->waiting[i + 1],
+                    (server->waitingCount - i - 1) * sizeof(Waiting));
+            server->waitingCount--;
+            break;
+        }
+    }
+
+    close(fd);
+}
+
+/*******************************************************************************
+* function name : sendSlot
+* input : Server *server, int fd, uint32_t slot
+* output : -
+* explanation : tell a player its slot and hand it the shared memory.
+*******************************************************************************/
+void sendSlot(Server *server, int fd, uint32_t slot) {
+    char control[CMSG_SPACE(sizeof(int))];
+    struct msghdr msg;
+    struct cmsghdr *cmsg;
+    struct iovec iov;
+    JoinReply reply;
+
+    reply.version = ARENA_VERSION;
+    reply.slot = slot;
+    iov.iov_base = &reply;
+    iov.iov_len = sizeof(reply);
+
+    memset(&msg, 0, sizeof(msg));
+    memset(control, 0, sizeof(control));
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+    msg.msg_control = control;
+    msg.msg_controllen = sizeof(control);
+
+    // the fd of the arena rides along with the reply
+    cmsg = CMSG_FIRSTHDR(&msg);
+    cmsg->cmsg_level = SOL_SOCKET;
+    cmsg->cmsg_type = SCM_RIGHTS;
+    cmsg->cmsg_len = CMSG_LEN(sizeof(int));
+    memcpy(CMSG_DATA(cmsg), &server->shmFD, sizeof(int));
+
+    // a player that already left is not an error of the server
+    if (sendmsg(fd, &msg, MSG_NOSIGNAL) != sizeof(reply)) {
+        perror("sendmsg error");
+    }
+}
+
+/*******************************************************************************
+* function name : abandonGame
+* input : Server *server, uint32_t slot, int ring - 0 black, 1 white
+* output : -
+* explanation : the player of ring died in its game. the game ends with no
+*               result, the opponent is woken by a word in the dead
+*               player's ring - it is the ring it sleeps on - and the server
+*               leaves the game for the dead player.
+*******************************************************************************/
+void abandonGame(Server *server, uint32_t slot, int ring) {
+    SharedGame *game = arenaSlot(server->arena, slot);
+    MoveEntry m;
+
+    fprintf(stderr, "%s player %u of game %u died, the game has no result\n",
+            ring ? "white" : "black",
+            ring ? game->whitePid : game->blackPid, game->gameNumber);
+
+    publishOnce(&game->result, NO_END);
+
+    // nobody writes the ring of the dead player any more
+    memset(&m, 0, sizeof(m));
+    m.moveNumber = UINT32_MAX;
+    m.square = SQUARE_NONE;
+    m.state = MOVE_ABANDONED;
+    ringPush(&game->rings[ring], &m);
+
+    gameLeave(server->arena, slot, ring);
+}
+
+/*******************************************************************************
+* function name : playerGone
+* input : Server *server, int fd
+* output : TRUE if fd is the connection of a player that was in a game
+* explanation : the player closed its connection. one that didn't leave its
+*               game first died in it.
+*******************************************************************************/
+Boolean playerGone(Server *server, int fd) {
+    uint32_t i;
+
+    for (i = 0; i < 2 * server->slots; i++) {
+        if (server->playerFD[i] == fd) {
+            break;
+        }
+    }
+    if (i == 2 * server->slots) {
+        return FALSE;
+    }
+
+    server->playerFD[i] = -1;
+    close(fd);
+
+    if (!(loadWord(&arenaSlot(server->arena, i / 2)->left) & (1u << (i % 2)))) {
+        abandonGame(server, i / 2, i % 2);
+    }
+
+    return TRUE;
+}
+
+/*******************************************************************************
+* function name : pairPlayers
+* input : Server *server
+* output : number of games started
+* explanation : start a game for every two waiting players while there are
+*               free slots. the first to connect plays black, the colours
+*               are in the memory before the players hear of their slot.
+*******************************************************************************/
+int pairPlayers(Server *server) {
+    int started = 0, paired = 0;
+
+    while (server->waitingCount - paired >= 2) {
+        Waiting *black = &server->waiting[paired], *white = black + 1;
+        uint32_t slot = arenaAlloc(server->arena, (uint32_t) black->pid,
+                                   (uint32_t) white->pid);
+
+        if (slot == SLOT_NONE) {
+            break;
+        }
+
+        server->startMs[slot] = wallMs();
+        sendSlot(server, black->fd, slot);
+        sendSlot(server, white->fd, slot);
+
+        // the players of the slot's last game left it, they may still be
+        // exiting
+        if (server->playerFD[2 * slot] >= 0) close(server->playerFD[2 * slot]);
+        if (server->playerFD[2 * slot + 1] >= 0) close(server->playerFD[2 * slot + 1]);
+        server->playerFD[2 * slot] = black->fd;
+        server->playerFD[2 * slot + 1] = white->fd;
+        paired += 2;
+        started++;
+    }
+
+    server->waitingCount -= paired;
+    memmove(server->waiting, server->waiting + paired,
+            server->waitingCount * sizeof(Waiting));
+    return started;
+}
+
 /*******************************************************************************
 * function name : main
 * input : int argc, char **argv
 * output : 0
-* explanation : main function
+* explanation : ex31 [-g slots] [-H]
+*               pair the players in the order they connect and host their
+*               games.
 *******************************************************************************/
 int main(int argc, char **argv) {
-    pid_t firstPID, secondPID;
-    int fifoFD;
-    char buffer[20];
-    key_t key;
-    int shmid;
-    char *sharedMemory, *shmBuf;
+    Server server;
+    struct epoll_event ev, events[MAX_EVENTS];
+    int listenFD, epollFD;
+    Boolean over = FALSE;
+    uint32_t slot;
+    pthread_t reaperThread, sigThread;
+    sigset_t set;
+    int opt;
 
-    // create channel for communication
-    if ((mkfifo("fifo_clientTOserver", O_CREAT|0777)) < 0) {
-        exitWithError("fifo error");
+    // one game by default
+    server.slots = 1;
+    server.single = TRUE;
+    server.finished = 0;
+    server.waiting = NULL;
+    server.waitingCount = 0;
+    server.waitingCapacity = 0;
+    server.huge = FALSE;
+    server.archiving = FALSE;
+    server.latencyAtExit = FALSE;
+    while ((opt = getopt(argc, argv, "g:HA:L")) != -1) {
+        switch (opt) {
+            case 'g': server.slots = atoi(optarg);
+                server.single = FALSE;
+                break;
+            case 'H': server.huge = TRUE;
+                break;
+            case 'A':
+                if (archiveWriterOpen(&server.archive, optarg) < 0) {
+                    exitWithError("archive error");
+                }
+                server.archiving = TRUE;
+                break;
+            case 'L': server.latencyAtExit = TRUE;
+                break;
+            default:
+                fprintf(stderr, "usage: %s [-g slots] [-H] [-A archive] [-L]\n",
+                        argv[0]);
+                exit(-1);
+        }
     }
 
-    // open for read only
-    if ((fifoFD = open("fifo_clientTOserver", O_RDWR)) < 0) {
-        exitWithError("open error");
+    if (server.slots < 1) {
+        server.slots = 1;
     }
 
-    // get first pid
-    if ((read(fifoFD, &firstPID, sizeof(pid_t))) < 0) {
-        exitWithError("read error");
+    if (!(server.startMs = calloc(server.slots, sizeof(uint64_t))) ||
+        !(server.playerFD = malloc(2 * server.slots * sizeof(int)))) {
+        exitWithError("calloc error");
+    }
+    for (slot = 0; slot < 2 * server.slots; slot++) {
+        server.playerFD[slot] = -1;
     }
 
-    // get second pid
-    if ((read(fifoFD, &secondPID, sizeof(pid_t))) < 0) {
-        exitWithError("read error");
+    // the signals are taken by the signal thread only
+    sigemptyset(&set);
+    sigaddset(&set, SIGUSR2);
+    sigaddset(&set, SIGINT);
+    sigaddset(&set, SIGTERM);
+    if (pthread_sigmask(SIG_BLOCK, &set, NULL) != 0) {
+        exitWithError("pthread_sigmask error");
     }
 
-    // remove the fifo
-    if ((unlink("fifo_clientTOserver")) < 0) {
-        exitWithError("unlink error");
+    // create channel for communication
+    listenFD = listenSocket();
+
+    if ((server.freedFD = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC)) < 0) {
+        exitWithError("eventfd error");
     }
 
-    key = ftok("ex31.c", 'k');
-    if (((key_t) - 1) == key) {
-        exitWithError("ftok error");
+    if ((epollFD = epoll_create1(EPOLL_CLOEXEC)) < 0) {
+        exitWithError("epoll_create1 error");
     }
 
-    // create shared memory
-    if ((shmid = shmget(key, 4096, IPC_CREAT | 0644)) < 0) {
-        exitWithError("shemget error");
+    ev.events = EPOLLIN;
+    ev.data.fd = listenFD;
+    if (epoll_ctl(epollFD, EPOLL_CTL_ADD, listenFD, &ev) < 0) {
+        exitWithError("epoll_ctl error");
     }
 
-    // attach to the shared memory
-    sharedMemory = (char *) shmat( shmid, NULL, 0);
-    if (((char *) - 1) == sharedMemory) {
-        exitWithError("shmat error");
+    ev.events = EPOLLIN;
+    ev.data.fd = server.freedFD;
+    if (epoll_ctl(epollFD, EPOLL_CTL_ADD, server.freedFD, &ev) < 0) {
+        exitWithError("epoll_ctl error");
     }
 
-    // initialize shared memory
-    memset(sharedMemory, 0, 4096);
+    // create shared memory
+    createArena(&server);
 
-    // signal first player
-    if ((kill(firstPID, SIGUSR1)) < 0) {
-        exitWithError("kill error");
+    if (pthread_create(&sigThread, NULL, signalThread, &server) != 0 ||
+        pthread_create(&reaperThread, NULL, reaper, &server) != 0) {
+        exitWithError("pthread_create error");
     }
 
-    // wait until the first player makes his move
-    sleep(1);
+    // in single game mode until the game is over, else for ever
+    while (!over) {
+        int n, i;
 
-    // signal first player
-    if ((kill(secondPID, SIGUSR1)) < 0) {
-        exitWithError("kill error");
-    }
+        if ((n = epoll_wait(epollFD, events, MAX_EVENTS, -1)) < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            exitWithError("epoll_wait error");
+        }
+
+        for (i = 0; i < n; i++) {
+            int fd = events[i].data.fd;
+
+            if (fd == listenFD) {
+                acceptPlayers(&server, listenFD, epollFD);
+            } else if (fd == server.freedFD) {
+                eventfd_t count;
+                eventfd_read(server.freedFD, &count);
+                // the one game is over and reaped
+                over = server.single;
+            } else if (!playerGone(&server, fd)) {
+                dropPlayer(&server, fd);
+            }
+        }
 
-    // busy waiting for end of game
-    while (sharedMemory[6] != 'e') {
-        sleep(1);
+        if (listenFD >= 0 && pairPlayers(&server) > 0 && server.single) {
+            // no more players, the ones still waiting see their connection
+            // close. the two playing are still watched
+            while (server.waitingCount > 0) {
+                dropPlayer(&server, server.waiting[0].fd);
+            }
+            close(listenFD);
+            listenFD = -1;
+            if ((unlink(SERVER_SOCKET)) < 0) {
+                exitWithError("unlink error");
+            }
+        }
     }
 
-    // end game
-    printf("GAME OVER !\n");
-    if (sharedMemory[7] == 'w') {
-        printf("Winning player: White\n");
-    } else if (sharedMemory[7] == 'b') {
-        printf("Winning player: Black\n");
-    } else {
-        printf("No winning player");
+    close(epollFD);
+    free(server.waiting);
+    for (slot = 0; slot < 2 * server.slots; slot++) {
+        if (server.playerFD[slot] >= 0) {
+            close(server.playerFD[slot]);
+        }
     }
+    free(server.playerFD);
 
-    // detach from the shared memory
-    if ((shmdt(sharedMemory)) <0 ) {
-        exitWithError("shmdt error");
+    // sleep until the game is over
+    pthread_join(reaperThread, NULL);
+    if (server.latencyAtExit) {
+        printLatency(&server);
     }
 
-    // remove shared memory
-    if ((shmctl(shmid, IPC_RMID, NULL)) < 0) {
-        exitWithError("shmctl error");
+    // unmap the shared memory, it is gone once the players are done too
+    if ((munmap(server.arena, server.size)) < 0) {
+        exitWithError("munmap error");
+    }
+    close(server.shmFD);
+    free(server.startMs);
+    if (server.archiving) {
+        archiveWriterClose(&server.archive);
     }
 
     return 0;
-}
\ No newline at end of file
+}
@@ -6,35 +6,90 @@
  */
 #include <stdio.h>
 #include <stdlib.h>
+#include <stdarg.h>
+#include <ctype.h>
+#include <errno.h>
 #include <unistd.h>
 #include <sys/fcntl.h>
 #include <signal.h>
 #include <sys/types.h>
-#include <sys/ipc.h>
-#include <sys/shm.h>
-
-#define BOARD_SIZE 8
-#define BLACK 2
-#define WHITE 1
-#define FREE 0
-#define MEM_SIZE 1024
-
-typedef enum {INVALID_SQUARE = 0,NO_SUCH_SQUARE, VALID_MOVE} MoveMode;
-typedef enum {BLACK_WIN = 1, WHITE_WIN, DRAW, NO_END} EndMode;
-typedef enum {FALSE = 0, TRUE} Boolean;
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <string.h>
+#include "othello.h"
+#include "search.h"
+#include "endgame.h"
+#include "book.h"
+#include "ipc.h"
+
+// default thinking time of the computer player
+#define DEFAULT_MOVE_TIME 1000
+// default transposition table size, in megabytes
+#define DEFAULT_TT_SIZE 16
+// the computer solves the game exactly from ENDGAME_EMPTIES empty squares
+// with ENDGAME_TIME ms a move, and from 2 more for every 8 times that time.
+// the hardest positions of that many empties take about half the time
+#define ENDGAME_EMPTIES 12
+#define ENDGAME_TIME 10
+// move files are read whole, this much at a time
+#define READ_CHUNK 65536
+// the printed board - a header, 8 rows of "0 0 0 0 0 0 0 0 \n" and an empty
+// line. a changed square takes 8 chars, less than 64 change between prints
+#define BOARD_TEXT_SIZE 700
+
+/*
+ * everything one player process knows about its game. nothing is global, so
+ * several games can live in one process.
+ */
 typedef struct {
-    int x;
-    int y;
-} Point;
-
-// board - global variable
-int board[BOARD_SIZE][BOARD_SIZE] = {FREE};
-// player - global variable
-int curPlayer;
-// sMBuf - shared memory pointer, global variable
-char *sMBuf;
-// end game state - global variable
-EndMode gameState;
+    // board, turn and move history
+    Position pos;
+    // the colour this process plays
+    int curPlayer;
+    // end game state
+    EndMode gameState;
+    // the shared memory of all the server's games, our game and its slot
+    GameArena *arena;
+    size_t mapSize;
+    SharedGame *shared;
+    uint32_t slot;
+    // the ring we write our moves to and the one we read the opponent's from
+    MoveRing *out;
+    MoveRing *in;
+    // our thinking time so far, in milliseconds
+    uint32_t clock;
+    // latencies of the moves, added to the server's when we leave
+    LatencyHistogram latency[LATENCY_STAGES];
+    // TRUE if the moves are chosen by the search instead of stdin
+    Boolean computer;
+    // time budget of one computer move, in milliseconds
+    int moveTime;
+    // transposition table size in megabytes, 0 for no table
+    int ttSize;
+    TransTable tt;
+    // search threads, all sharing tt
+    int threads;
+    SearchPool pool;
+    // empty squares left when the exact solver takes over
+    int endgameEmpties;
+    EndgameContext endgame;
+    // opening book, shared read only with the other players
+    OpeningBook book;
+    // TRUE to print nothing but the result
+    Boolean quiet;
+    // TRUE to print only the squares that changed, the discs last printed
+    Boolean diff;
+    Bitboard shown[3];
+    Boolean shownValid;
+    // TRUE if the moves are read from a file instead of stdin (-i)
+    Boolean scripted;
+    // the moves of the file, next is the one to play
+    int *script;
+    int scriptCount;
+    int scriptNext;
+} Game;
 
 /*******************************************************************************
 * function name : exitWithError
@@ -47,708 +102,1091 @@ void exitWithError(char *msg) {
     exit(-1);
 }
 
+/*******************************************************************************
+* function name : report
+* input : Game *game, const char *format, ...
+* output : -
+* explanation : printf, unless the game is quiet.
+*******************************************************************************/
+void report(Game *game, const char *format, ...) {
+    va_list args;
+
+    if (game->quiet) {
+        return;
+    }
+
+    va_start(args, format);
+    vprintf(format, args);
+    va_end(args);
+}
+
 /*******************************************************************************
 * function name : initBoard
-* input : -
+* input : Game *game
 * output : -
 * explanation : initialize the board.
 *******************************************************************************/
-void initBoard() {
-    board[3][3] = BLACK;
-    board[4][4] = BLACK;
-    board[4][3] = WHITE;
-    board[3][4] = WHITE;
+void initBoard(Game *game) {
+    initPosition(&game->pos);
 
     // set game state
-    gameState = NO_END;
+    game->gameState = NO_END;
+
+    // nothing was printed of this board
+    game->shownValid = FALSE;
 }
 
 /*******************************************************************************
-* function name : printBoard
-* input : -
-* output : -
-* explanation : print the board.
+* function name : checkEndGame
+* input : Game *game
+* output : NO_END if game is on or WHITE_WIN, BLACK_WIN and DRAW
+* explanation : check for if the game has ended. a player without a legal
+*               move passes, the game ends when neither player can move.
 *******************************************************************************/
-void printBoard() {
-    int i,j;
-    printf("The board is:\n");
-    for (i = 0; i < BOARD_SIZE; ++i) {
-        for (j = 0; j < BOARD_SIZE; ++j) {
-            printf("%d ", board[i][j]);
-        }
-        printf("\n");
+EndMode checkEndGame(Game *game) {
+    Position *pos = &game->pos;
+
+    // the side to move can play
+    if (pos->legalMoves) {
+        return NO_END;
     }
-    printf("\n");
+
+    // the side to move passes and the opponent plays again
+    if (mustPass(pos)) {
+        makePass(pos);
+        return NO_END;
+    }
+
+    return positionResult(pos);
 }
 
 /*******************************************************************************
-* function name : changeCoinsOnBoard
-* input : Point points[], int player
+* function name : writeAll
+* input : int fd, const char *buf, size_t size
 * output : -
-* explanation : set the correct coins on the board.
+* explanation : write all of buf, a signal or a full pipe may cut a write.
 *******************************************************************************/
-void changeCoinsOnBoard(Point points[], int player) {
-    int j = 0;
-    while (j < BOARD_SIZE) {
-        Point p = points[j];
-        if (p.x == -1) {
-            break;
-        }
+void writeAll(int fd, const char *buf, size_t size) {
+    while (size > 0) {
+        ssize_t n = write(fd, buf, size);
 
-        // place the player's coins on the board
-        board[p.y][p.x] = player;
-        j++;
+        if (n < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            exitWithError("write error");
+        }
+        buf += n;
+        size -= n;
     }
 }
 
 /*******************************************************************************
-* function name : checkAbove
-* input : int x, int y, int player, Boolean writeToBoard
-* output : VALID_MOVE if all ok, else INVALID_SQUARE
-* explanation : check for a valid move
+* function name : renderBoard
+* input : const Position *pos, char *text
+* output : length of the text
+* explanation : the whole board as printBoard prints it. text must hold
+*               BOARD_TEXT_SIZE chars.
 *******************************************************************************/
-MoveMode checkAbove(int x, int y, int player, Boolean writeToBoard) {
-    int i, k = 0;
-    Point tempArr[8];
-
-    if (board[y - 1][x] == player) return INVALID_SQUARE;
-
-    // check above
-    for (i = y; i >=0; --i) {
-        Point p;
-        // didn't find a matching color
-        if (board[i][x] == FREE && (i != y)) {
-            return  INVALID_SQUARE;
-        }
-
-        // only if the same color and not next to it
-        if (board[i][x] == player && (i != y - 1) && (i != y))  {
-            if (writeToBoard) {
-                // set an end
-                p.x = -1;
-                tempArr[k++] = p;
-                changeCoinsOnBoard(tempArr, player);
-            }
-            return VALID_MOVE;
+int renderBoard(const Position *pos, char *text) {
+    static const char header[] = "The board is:\n";
+    char *t = text;
+    int sq;
+
+    memcpy(t, header, sizeof(header) - 1);
+    t += sizeof(header) - 1;
+    for (sq = 0; sq < SQUARES; sq++) {
+        *t++ = '0' + squareContent(pos, sq);
+        *t++ = ' ';
+        if (sq % BOARD_SIZE == BOARD_SIZE - 1) {
+            *t++ = '\n';
         }
-
-        // add candidate point to the temp array
-        p.x = x;
-        p.y = i;
-        tempArr[k++] = p;
     }
+    *t++ = '\n';
 
-    return INVALID_SQUARE;
+    return t - text;
 }
 
 /*******************************************************************************
-* function name : checkBelow
-* input : int x, int y, int player, Boolean writeToBoard
-* output : VALID_MOVE if all ok, else INVALID_SQUARE
-* explanation : check for a valid move
+* function name : renderChanges
+* input : const Position *pos, const Bitboard shown[3], char *text
+* output : length of the text
+* explanation : only the squares that changed since the shown discs, like
+*               "The board changed: [3,2]=2 [3,3]=2". text must hold
+*               BOARD_TEXT_SIZE chars.
 *******************************************************************************/
-MoveMode checkBelow(int x, int y, int player, Boolean writeToBoard) {
-    int i, k = 0;
-    Point tempArr[8];
-
-    if (board[y + 1][x] == player) return INVALID_SQUARE;
-
-    // check above
-    for (i = y; i < BOARD_SIZE; ++i) {
-        Point p;
-        // didn't find a matching color
-        if (board[i][x] == FREE && (i != y)) {
-            return  INVALID_SQUARE;
-        }
-
-        // only if the same color and not next to it
-        if (board[i][x] == player && (i != y + 1) && (i != y)) {
-            if (writeToBoard) {
-                // set an end
-                p.x = -1;
-                tempArr[k++] = p;
-                changeCoinsOnBoard(tempArr, player);
-            }
-            return VALID_MOVE;
-        }
+int renderChanges(const Position *pos, const Bitboard shown[3], char *text) {
+    Bitboard changed = (pos->discs[WHITE] ^ shown[WHITE]) |
+                       (pos->discs[BLACK] ^ shown[BLACK]);
+    int length;
 
-        p.x = x;
-        p.y = i;
-        tempArr[k++] = p;
+    if (!changed) {
+        return sprintf(text, "The board didn't change\n");
     }
 
-    return  INVALID_SQUARE;
+    length = sprintf(text, "The board changed:");
+    while (changed) {
+        int sq = __builtin_ctzll(changed);
+        changed &= changed - 1;
+        length += sprintf(text + length, " [%d,%d]=%d", sq % BOARD_SIZE,
+                          sq / BOARD_SIZE, squareContent(pos, sq));
+    }
+    text[length++] = '\n';
+
+    return length;
 }
 
 /*******************************************************************************
-* function name : checkRight
-* input : int x, int y, int player, Boolean writeToBoard
-* output : VALID_MOVE if all ok, else INVALID_SQUARE
-* explanation : check for a valid move
+* function name : printBoard
+* input : Game *game
+* output : -
+* explanation : print the board in one write, or in diff mode only what
+*               changed since it was last printed. nothing when quiet.
 *******************************************************************************/
-MoveMode checkRight(int x, int y, int player, Boolean writeToBoard) {
-    int i, k = 0;
-    Point tempArr[8];
-
-    if (board[y][x + 1] == player) return INVALID_SQUARE;
-
-    // check above
-    for (i = x; i < BOARD_SIZE; ++i) {
-        Point p;
-        // didn't find a matching color
-        if (board[y][i] == FREE && (i != x)) {
-            return  INVALID_SQUARE;
-        }
-
-        // only if the same color and not next to it
-        if (board[y][i] == player && (i != x + 1) && (i != x)) {
-            if (writeToBoard) {
-                // set an end
-                p.x = -1;
-                tempArr[k++] = p;
-                changeCoinsOnBoard(tempArr, player);
-            }
-            return VALID_MOVE;
-        }
+void printBoard(Game *game) {
+    char text[BOARD_TEXT_SIZE];
+    int length;
 
-        p.x = i;
-        p.y = y;
-        tempArr[k++] = p;
+    if (game->quiet) {
+        return;
+    }
+
+    if (game->diff && game->shownValid) {
+        length = renderChanges(&game->pos, game->shown, text);
+    } else {
+        length = renderBoard(&game->pos, text);
     }
+    game->shown[WHITE] = game->pos.discs[WHITE];
+    game->shown[BLACK] = game->pos.discs[BLACK];
+    game->shownValid = TRUE;
 
-    return  INVALID_SQUARE;
+    // whatever stdio holds was printed before the board
+    fflush(stdout);
+    writeAll(STDOUT_FILENO, text, length);
 }
 
 /*******************************************************************************
-* function name : checkLeft
-* input : int x, int y, int player, Boolean writeToBoard
-* output : VALID_MOVE if all ok, else INVALID_SQUARE
-* explanation : check for a valid move
+* function name : checkMove
+* input : Game *game, int x, int y, int player
+* output : VALID_MOVE if the move was played, NO_SUCH_SQUARE if off the
+*          board, else INVALID_SQUARE
+* explanation : play the move if it is legal for player.
 *******************************************************************************/
-MoveMode checkLeft(int x, int y, int player, Boolean writeToBoard) {
-    int i, k = 0;
-    Point tempArr[8];
-
-    if (board[y][x - 1] == player) return INVALID_SQUARE;
-
-    // check above
-    for (i = x; i >= 0; --i) {
-        Point p;
-        // didn't find a matching color
-        if (board[y][i] == FREE && (i != x)) {
-            return  INVALID_SQUARE;
-        }
-
-        // only if the same color and not next to it
-        if (board[y][i] == player && (i != x - 1) && (i != x)) {
-            if (writeToBoard) {
-                // set an end
-                p.x = -1;
-                tempArr[k++] = p;
-                changeCoinsOnBoard(tempArr, player);
-            }
-            return VALID_MOVE;
-        }
+MoveMode checkMove(Game *game, int x, int y, int player) {
+    // trivial checks
+    if (x >= BOARD_SIZE || x < 0) {
+        return NO_SUCH_SQUARE;
+    }
+
+    if (y >= BOARD_SIZE || y < 0) {
+        return NO_SUCH_SQUARE;
+    }
+
+    if (game->pos.sideToMove != player) {
+        return INVALID_SQUARE;
+    }
 
-        p.x = i;
-        p.y = y;
-        tempArr[k++] = p;
+    if (!makeMove(&game->pos, SQUARE(x, y))) {
+        return INVALID_SQUARE;
     }
 
-    return  INVALID_SQUARE;
+    return VALID_MOVE;
 }
 
 /*******************************************************************************
-* function name : checkUpperRight
-* input : int x, int y, int player, Boolean writeToBoard
-* output : VALID_MOVE if all ok, else INVALID_SQUARE
-* explanation : check for a valid move
+* function name : checkMoves
+* input : Position *pos, const int moves[], int n, const char **why
+* output : the index of the first move that can't be played, n if all can
+* explanation : play moves on pos. written passes must be real ones, missing
+*               ones are played where they have to be. *why tells what is
+*               wrong with the bad move.
 *******************************************************************************/
-MoveMode checkUpperRight(int x, int y, int player, Boolean writeToBoard) {
-    int i, k = 0, j = y;
-    Point tempArr[8];
-
-    if (board[y - 1][x + 1] == player) return INVALID_SQUARE;
-
-    // check above
-    for (i = x; i < BOARD_SIZE; ++i) {
-        Point p;
-        // didn't find a matching color
-        if (board[j][i] == FREE && (i != x)) {
-            return  INVALID_SQUARE;
-        }
-
-        // only if the same color and not next to it
-        if (board[j][i] == player && (i != x + 1) && (i != x)) {
-            if (writeToBoard) {
-                // set an end
-                p.x = -1;
-                tempArr[k++] = p;
-                changeCoinsOnBoard(tempArr, player);
+int checkMoves(Position *pos, const int moves[], int n, const char **why) {
+    int i;
+
+    for (i = 0; i < n; i++) {
+        if (moves[i] == PASS_MOVE) {
+            if (!mustPass(pos)) {
+                *why = "is not a pass";
+                return i;
             }
-            return VALID_MOVE;
+            makePass(pos);
+            continue;
         }
 
-        p.x = i;
-        p.y = j;
-        tempArr[k++] = p;
-        j--;
-        if (j < 0) break;
+        if (mustPass(pos)) {
+            makePass(pos);
+        }
+        if (!(pos->legalMoves & SQUARE_BIT(moves[i]))) {
+            *why = "is illegal";
+            return i;
+        }
+        makeMove(pos, moves[i]);
     }
 
-    return  INVALID_SQUARE;
+    return n;
 }
 
 /*******************************************************************************
-* function name : checkUpperLeft
-* input : int x, int y, int player, Boolean writeToBoard
-* output : VALID_MOVE if all ok, else INVALID_SQUARE
-* explanation : check for a valid move
+* function name : expectedReply
+* input : Game *game
+* output : the reply the search expects to our move, SQUARE_NONE if none
+* explanation : the best move the transposition table holds for the
+*               opponent.
 *******************************************************************************/
-MoveMode checkUpperLeft(int x, int y, int player, Boolean writeToBoard) {
-    int i, k = 0, j = y;
-    Point tempArr[8];
-
-    if (board[y - 1][x - 1] == player) return INVALID_SQUARE;
-
-    // check above
-    for (i = x; i >= 0; --i) {
-        Point p;
-        // didn't find a matching color
-        if (board[j][i] == FREE && (i != x)) {
-            return  INVALID_SQUARE;
-        }
-
-        // only if the same color and not next to it
-        if (board[j][i] == player && (i != x - 1) && (i != x)) {
-            if (writeToBoard) {
-                // set an end
-                p.x = -1;
-                tempArr[k++] = p;
-                changeCoinsOnBoard(tempArr, player);
-            }
-            return VALID_MOVE;
-        }
-
-        p.x = i;
-        p.y = j;
-        tempArr[k++] = p;
-        j--;
-        if (j < 0) break;
+int expectedReply(Game *game) {
+    TTData data;
+
+    if (!game->computer || !game->pool.tt ||
+        game->pos.sideToMove == game->curPlayer ||
+        !ttProbe(game->pool.tt, game->pos.hash, &data) ||
+        data.move >= SQUARES || !(game->pos.legalMoves & SQUARE_BIT(data.move))) {
+        return SQUARE_NONE;
     }
 
-    return  INVALID_SQUARE;
+    return data.move;
 }
 
 /*******************************************************************************
-* function name : checkDownLeft
-* input : int x, int y, int player, Boolean writeToBoard
-* output : VALID_MOVE if all ok, else INVALID_SQUARE
-* explanation : check for a valid move
+* function name : publishMove
+* input : Game *game, MoveEntry *m, long long chosenNs
+* output : -
+* explanation : put the move in our ring, with the times the opponent
+*               measures its delivery from. the push may wake the opponent
+*               on our core, so publishing ends with the time in the entry.
 *******************************************************************************/
-MoveMode checkDownLeft(int x, int y, int player, Boolean writeToBoard) {
-    int i, k = 0, j = y;
-    Point tempArr[8];
-
-    if (board[y + 1][x - 1] == player) return INVALID_SQUARE;
-
-    // check above
-    for (i = x; i >= 0; --i) {
-        Point p;
-        // didn't find a matching color
-        if (board[j][i] == FREE && (i != x)) {
-            return  INVALID_SQUARE;
-        }
-
-        // only if the same color and not next to it
-        if (board[j][i] == player && (i != x - 1) && (i != x)) {
-            if (writeToBoard) {
-                // set an end
-                p.x = -1;
-                tempArr[k++] = p;
-                changeCoinsOnBoard(tempArr, player);
-            }
-            return VALID_MOVE;
-        }
-
-        p.x = i;
-        p.y = j;
-        tempArr[k++] = p;
-        j++;
-        if (j >= BOARD_SIZE) break;
-    }
-
-    return  INVALID_SQUARE;
+void publishMove(Game *game, MoveEntry *m, long long chosenNs) {
+    m->chosenNs = chosenNs;
+    m->publishedNs = nowNs();
+    latencyRecord(&game->latency[LATENCY_PUBLISH], m->publishedNs - chosenNs);
+    ringPush(game->out, m);
 }
 
 /*******************************************************************************
-* function name : checkDownRight
-* input : int x, int y, int player, Boolean writeToBoard
-* output : VALID_MOVE if all ok, else INVALID_SQUARE
-* explanation : check for a valid move
+* function name : sendPassToSharedMemory
+* input : Game *game, long long chosenNs
+* output : -
+* explanation : tell the opponent that we have no move.
 *******************************************************************************/
-MoveMode checkDownRight(int x, int y, int player, Boolean writeToBoard) {
-    int i, k = 0, j = y;
-    Point tempArr[8];
-
-    if (board[y + 1][x + 1] == player) return INVALID_SQUARE;
-
-    // check above
-    for (i = x; i < BOARD_SIZE; ++i) {
-        Point p;
-        // didn't find a matching color
-        if (board[j][i] == FREE && (i != x)) {
-            return  INVALID_SQUARE;
-        }
-
-        // only if the same color and not next to it
-        if (board[j][i] == player && (i != x + 1) && (i != x)) {
-            if (writeToBoard) {
-                // set an end
-                p.x = -1;
-                tempArr[k++] = p;
-                changeCoinsOnBoard(tempArr, player);
-            }
-            return VALID_MOVE;
-        }
+void sendPassToSharedMemory(Game *game, long long chosenNs) {
+    MoveEntry m;
+
+    // the pass is already played on our board
+    memset(&m, 0, sizeof(m));
+    m.moveNumber = game->pos.ply;
+    m.square = SQUARE_NONE;
+    m.state = (uint8_t) game->gameState;
+    m.ponder = SQUARE_NONE;
+    m.clock = game->clock;
+    publishMove(game, &m, chosenNs);
+}
 
-        p.x = i;
-        p.y = j;
-        tempArr[k++] = p;
-        j++;
-        if (j >= BOARD_SIZE) break;
-    }
+/*******************************************************************************
+* function name : sendMoveToSharedMemory
+* input : Game *game, int x, int y, int moveNumber, long long chosenNs
+* output : -
+* explanation : write the move to the shared memory. the board may already
+*               have the opponent's pass after it, so the caller numbers the
+*               move.
+*******************************************************************************/
+void sendMoveToSharedMemory(Game *game, int x, int y, int moveNumber,
+                            long long chosenNs) {
+    MoveEntry m;
+
+    memset(&m, 0, sizeof(m));
+    m.moveNumber = moveNumber;
+    m.square = (uint8_t) SQUARE(x, y);
+    m.state = (uint8_t) game->gameState;
+    m.ponder = (uint8_t) expectedReply(game);
+    m.clock = game->clock;
+    publishMove(game, &m, chosenNs);
+}
 
-    return  INVALID_SQUARE;
+/*******************************************************************************
+* function name : recordArrival
+* input : Game *game, const MoveEntry *m, long long observedNs,
+*         long long appliedNs
+* output : -
+* explanation : the latencies of an opponent's move, from its times and
+*               ours.
+*******************************************************************************/
+void recordArrival(Game *game, const MoveEntry *m, long long observedNs,
+                   long long appliedNs) {
+    latencyRecord(&game->latency[LATENCY_DELIVER], observedNs - m->publishedNs);
+    latencyRecord(&game->latency[LATENCY_APPLY], appliedNs - observedNs);
+    latencyRecord(&game->latency[LATENCY_MOVE], appliedNs - m->chosenNs);
 }
 
 /*******************************************************************************
-* function name : checkMove
-* input : int x, int y, int player, Boolean writeToBoard
-* output : VALID_MOVE if all ok, else INVALID_SQUARE
-* explanation : start a series of checks to find if a move is valid
+* function name : scriptError
+* input : Game *game, int index, const char *what
+* output : -
+* explanation : stop on move index of the script, it is printed as in the
+*               game records.
 *******************************************************************************/
-MoveMode checkMove(int x, int y, int player ,Boolean writeToBoard) {
-    int i, j;
-    int savePos[8] = {-2};
+void scriptError(Game *game, int index, const char *what) {
+    int sq = game->script[index];
 
-    // trivial checks
-    if (x >= BOARD_SIZE || x < 0) {
-        return NO_SUCH_SQUARE;
+    if (sq == PASS_MOVE) {
+        fprintf(stderr, "move %d of the script (--) %s\n", index + 1, what);
+    } else {
+        fprintf(stderr, "move %d of the script (%c%d) %s\n", index + 1,
+                'a' + sq % BOARD_SIZE, 1 + sq / BOARD_SIZE, what);
     }
+    exit(-1);
+}
 
-    if (y >= BOARD_SIZE || y < 0) {
-        return NO_SUCH_SQUARE;
-    }
+/*******************************************************************************
+* function name : getMoveFromSharedMemory
+* input : Game *game, const MoveEntry *m, long long observedNs
+* output : -
+* explanation : execute the move the other player wrote, observedNs is
+*               when we took it from the ring.
+*******************************************************************************/
+void getMoveFromSharedMemory(Game *game, const MoveEntry *m, long long observedNs) {
+    int oppPlayer = OPPONENT(game->curPlayer);
 
-    if (board[y][x] != FREE) {
-        return INVALID_SQUARE;
+    // the other player passed - the turn was already given back to us
+    if (m->square == SQUARE_NONE) {
+        recordArrival(game, m, observedNs, nowNs());
+        return;
     }
 
-    // start checking non trivial checks
-
-    savePos[0] = checkAbove(x, y, player, writeToBoard); // check above
-    savePos[1] = checkBelow(x, y, player, writeToBoard); // check below
-    savePos[2] = checkRight(x, y, player, writeToBoard); // check right
-    savePos[3] = checkLeft(x, y, player, writeToBoard); // check left
-    savePos[4] = checkUpperRight(x, y, player, writeToBoard); // check upper right
-    savePos[5] = checkUpperLeft(x, y, player, writeToBoard); // check upper left
-    savePos[6] = checkDownRight(x, y, player, writeToBoard); // check down right
-    savePos[7] = checkDownLeft(x, y, player, writeToBoard); // check down left
+    // preform other player move
+    checkMove(game, m->square % BOARD_SIZE, m->square / BOARD_SIZE, oppPlayer);
 
-    for (i = 0; i < BOARD_SIZE; i++) {
-        if (savePos[i] != INVALID_SQUARE) {
-            return VALID_MOVE;
+    // the script has the other player's moves too, it must keep to them
+    if (game->scripted) {
+        while (game->scriptNext < game->scriptCount &&
+               game->script[game->scriptNext] == PASS_MOVE) {
+            game->scriptNext++;
+        }
+        if (game->scriptNext < game->scriptCount &&
+            game->script[game->scriptNext] != m->square) {
+            scriptError(game, game->scriptNext, "is not what the other player played");
+        }
+        if (game->scriptNext < game->scriptCount) {
+            game->scriptNext++;
         }
     }
 
-    return INVALID_SQUARE;
+    // check if the game is over
+    game->gameState = checkEndGame(game);
+
+    recordArrival(game, m, observedNs, nowNs());
 }
 
 /*******************************************************************************
-* function name : checkEndGame
-* input : int player
-* output : NO_END if game is on or WHITE_WIN, BLACK_WIN and DRAW
-* explanation : check for if the game has ended
+* function name : readMove
+* input : Game *game, int *x, int *y
+* output : -
+* explanation : read squares from the user until a legal one is played.
 *******************************************************************************/
-EndMode checkEndGame(int player) {
-    int i, j;
-    int black = 0, white = 0;
-    Boolean playerHasMoves = FALSE;
-
-    for (i = 0; i < BOARD_SIZE; i++) {
-        for (j = 0; j < BOARD_SIZE; j ++) {
-            if (board[i][j] == FREE) {
-                if (checkMove(j, i, player, FALSE) == VALID_MOVE) {
-                    playerHasMoves = TRUE;
-                }
-            }
+void readMove(Game *game, int *x, int *y) {
+    MoveMode m;
 
-            if (board[i][j] == WHITE) {
-                white++;
-            } else if (board[i][j] == BLACK) {
-                black++;
-            }
+    report(game, "Please choose a square\n");
+    do {
+        // with nothing left to read we would ask for ever
+        if (scanf("\n[%d,%d]", x, y) != 2) {
+            fprintf(stderr, "no move to read\n");
+            exit(-1);
         }
-    }
 
-    // both players can still play
-    if (playerHasMoves) {
-        return NO_END;
+        m = checkMove(game, *x, *y, game->curPlayer);
+        if (m == NO_SUCH_SQUARE) {
+            report(game, "No such square\n");
+        } else if (m == INVALID_SQUARE) {
+            report(game, "This square is invalid\n");
+        } else {
+            // valid move
+            break;
+        }
+
+        report(game, "Please choose another square\n");
+    } while (TRUE);
+}
+
+/*******************************************************************************
+* function name : readAll
+* input : const char *path - a file, "-" for stdin
+* output : the whole file, ending with '\0'
+* explanation : the file is read in big chunks, so a pipe is read as fast
+*               as a file.
+*******************************************************************************/
+char *readAll(const char *path) {
+    int fd = strcmp(path, "-") ? open(path, O_RDONLY) : STDIN_FILENO;
+    size_t size = 0, capacity = 0;
+    char *text = NULL;
+    ssize_t n;
+
+    if (fd < 0) {
+        exitWithError("open error");
     }
 
-    // if one of them has no legal move
-    if (!playerHasMoves) {
-        if (white > black) {
-            return WHITE_WIN;
+    do {
+        if (capacity - size < READ_CHUNK + 1) {
+            capacity = capacity ? capacity * 2 : READ_CHUNK + 1;
+            if (!(text = realloc(text, capacity))) {
+                exitWithError("realloc error");
+            }
         }
 
-        if (white < black) {
-            return BLACK_WIN;
+        n = read(fd, text + size, READ_CHUNK);
+        if (n < 0 && errno != EINTR) {
+            exitWithError("read error");
+        }
+        if (n > 0) {
+            size += n;
         }
+    } while (n != 0);
+    text[size] = '\0';
+
+    if (fd != STDIN_FILENO) {
+        close(fd);
     }
 
-    return DRAW;
+    return text;
 }
 
 /*******************************************************************************
-* function name : charToPlayer
-* input : char c
-* output : WHITE or BLACK
-* explanation : translate char to player.
+* function name : parseMoveLine
+* input : const char **text, int moves[], int max
+* output : number of moves on the line, -1 if it has something else
+* explanation : the moves of one line, as typed ("[3,4]") or as in the
+*               game records ("d5", "--" or "pa" for a pass). a '#' starts
+*               a comment. *text moves to the next line.
 *******************************************************************************/
-int charToPlayer(char c) {
-    if (c == 'w') return WHITE;
-    if (c == 0) return curPlayer; // if it's 0 means the first player didn't made a move
-    return BLACK;
+int parseMoveLine(const char **text, int moves[], int max) {
+    const char *s = *text;
+    int n = 0;
+
+    while (*s && *s != '\n') {
+        int sq, x, y, length;
+
+        if (isspace((unsigned char) *s)) {
+            s++;
+            continue;
+        }
+
+        if (*s == '#') {
+            while (*s && *s != '\n') s++;
+            break;
+        }
+
+        if (sscanf(s, "[%d,%d]%n", &x, &y, &length) == 2) {
+            if (x < 0 || x >= BOARD_SIZE || y < 0 || y >= BOARD_SIZE) {
+                n = -1;
+                break;
+            }
+            sq = SQUARE(x, y);
+            s += length;
+        } else if (!strncmp(s, "pa", 2) || !strncmp(s, "--", 2)) {
+            sq = PASS_MOVE;
+            s += 2;
+        } else if ((sq = parseSquare(s)) >= 0) {
+            s += 2;
+        } else {
+            n = -1;
+            break;
+        }
+
+        if (n == max) {
+            n = -1;
+            break;
+        }
+        moves[n++] = sq;
+    }
+
+    // the rest of a bad line is skipped
+    while (*s && *s != '\n') s++;
+    *text = *s ? s + 1 : s;
+
+    return n;
 }
 
 /*******************************************************************************
-* function name : playerToChar
-* input : int player
-* output : 'w' or 'b'
-* explanation : translate player to char.
+* function name : loadScript
+* input : Game *game, const char *path
+* output : -
+* explanation : read all the moves of path before the game starts, any line
+*               that isn't moves stops the player. the script is the record
+*               of the game, it is replayed here so an illegal move stops
+*               the player before it plays.
 *******************************************************************************/
-char playerToChar(int player) {
-    if (player == WHITE) return 'w';
-    return 'b';
+void loadScript(Game *game, const char *path) {
+    char *text = readAll(path);
+    const char *s = text;
+    int moves[MAX_PLIES];
+    int capacity = 0, line = 0, bad;
+    const char *why;
+
+    game->script = NULL;
+    game->scriptCount = game->scriptNext = 0;
+
+    while (*s) {
+        int n = parseMoveLine(&s, moves, MAX_PLIES);
+
+        line++;
+        if (n < 0) {
+            fprintf(stderr, "%s:%d: not a list of moves\n", path, line);
+            exit(-1);
+        }
+
+        if (game->scriptCount + n > capacity) {
+            capacity = (game->scriptCount + n) * 2;
+            if (!(game->script = realloc(game->script, capacity * sizeof(int)))) {
+                exitWithError("realloc error");
+            }
+        }
+        memcpy(game->script + game->scriptCount, moves, n * sizeof(int));
+        game->scriptCount += n;
+    }
+    free(text);
+
+    if (!game->scriptCount) {
+        fprintf(stderr, "%s: no moves\n", path);
+        exit(-1);
+    }
+
+    initPosition(&game->pos);
+    bad = checkMoves(&game->pos, game->script, game->scriptCount, &why);
+    if (bad < game->scriptCount) {
+        scriptError(game, bad, why);
+    }
 }
 
 /*******************************************************************************
-* function name : sendMoveToSharedMemory
-* input : int player, int x, int y
+* function name : scriptMove
+* input : Game *game, int *x, int *y
 * output : -
-* explanation : write the move to the shared memory.
+* explanation : play the next move of the script. passes are played by
+*               themselves, so the written ones are skipped. the script was
+*               checked, a move that can't be played means the other player
+*               left it.
 *******************************************************************************/
-void sendMoveToSharedMemory(int player, int x, int y) {
-    char p = playerToChar(player);
-    sprintf(sMBuf, "%c%d%d", p, x, y);
+void scriptMove(Game *game, int *x, int *y) {
+    while (game->scriptNext < game->scriptCount &&
+           game->script[game->scriptNext] == PASS_MOVE) {
+        game->scriptNext++;
+    }
+    if (game->scriptNext == game->scriptCount) {
+        fprintf(stderr, "no moves left in the script\n");
+        exit(-1);
+    }
+
+    *x = game->script[game->scriptNext] % BOARD_SIZE;
+    *y = game->script[game->scriptNext] / BOARD_SIZE;
+    if (checkMove(game, *x, *y, game->curPlayer) != VALID_MOVE) {
+        scriptError(game, game->scriptNext, "can't be played in this game");
+    }
+    game->scriptNext++;
+    report(game, "Player plays [%d,%d]\n", *x, *y);
 }
 
 /*******************************************************************************
-* function name : getMoveFromSharedMemory
-* input : -
+* function name : searchMove
+* input : Game *game, int *x, int *y
 * output : -
-* explanation : get the move from the shared memory and execute it.
+* explanation : let the search choose a square and play it.
 *******************************************************************************/
-void getMoveFromSharedMemory() {
-    int x, y;
-    int oppPlayer = (curPlayer == BLACK) ? WHITE:BLACK;
+void searchMove(Game *game, int *x, int *y) {
+    SearchPool *pool = &game->pool;
+    Position *pos = &game->pos;
+    int empties = SQUARES - pos->discCount[WHITE] - pos->discCount[BLACK];
+    double seconds;
+    uint64_t nodes = 0, probes = 0, hits = 0;
+    int i, sq, score;
+
+    // known opening
+    if ((sq = bookMove(&game->book, pos)) >= 0) {
+        *x = sq % BOARD_SIZE;
+        *y = sq / BOARD_SIZE;
+        checkMove(game, *x, *y, game->curPlayer);
+        report(game, "Computer plays [%d,%d] (book)\n", *x, *y);
+        return;
+    }
 
-    x = sMBuf[1] - '0';
-    y = sMBuf[2] - '0';
+    // near the end play perfectly, if the solver finishes in time
+    if (empties <= game->endgameEmpties) {
+        long long start = nowNs();
+        int left;
+        game->endgame.tt = pool->tt;
+        if (pool->tt) {
+            ttNewSearch(pool->tt);
+        }
 
-    // preform other player move
-    checkMove(x, y, oppPlayer, TRUE);
+        if (solveEndgame(&game->endgame, pos, game->moveTime, &sq, &score)) {
+            *x = sq % BOARD_SIZE;
+            *y = sq / BOARD_SIZE;
+            checkMove(game, *x, *y, game->curPlayer);
+            report(game, "Computer plays [%d,%d] (solved, final disc difference "
+                   "%d, %llu nodes in %.3f sec)\n", *x, *y, score,
+                   (unsigned long long) game->endgame.nodes,
+                   (nowNs() - start) / 1e9);
+            return;
+        }
 
-    // check if current player has moves
-    gameState = checkEndGame(curPlayer);
+        // the search only gets what is left of the move's time
+        left = game->moveTime - (int) ((nowNs() - start) / 1000000);
+        report(game, "End game not solved in time, searching\n");
+        sq = chooseMove(pool, pos, left > 1 ? left : 1);
+    } else {
+        sq = chooseMove(pool, pos, game->moveTime);
+    }
+    seconds = pool->elapsed / 1e9;
+
+    *x = sq % BOARD_SIZE;
+    *y = sq / BOARD_SIZE;
+    checkMove(game, *x, *y, game->curPlayer);
+
+    for (i = 0; i < pool->threads; i++) {
+        nodes += pool->ctx[i].nodes;
+        probes += pool->ctx[i].ttProbes;
+        hits += pool->ctx[i].ttHits;
+    }
+
+    report(game, "Computer plays [%d,%d] (depth %d, score %d, %llu nodes, "
+           "%.0f nodes/sec)\n", *x, *y, pool->ctx[0].depth,
+           pool->ctx[0].bestScore, (unsigned long long) nodes,
+           seconds > 0 ? nodes / seconds : 0.0);
+    if (pool->threads > 1) {
+        for (i = 0; i < pool->threads; i++) {
+            report(game, "  thread %d: depth %d, %.0f nodes/sec\n", i,
+                   pool->ctx[i].depth,
+                   seconds > 0 ? pool->ctx[i].nodes / seconds : 0.0);
+        }
+    }
+    if (pool->tt) {
+        report(game, "Transposition table: %.1f%% hits, %.1f%% full\n",
+               ttHitRate(probes, hits), ttFill(pool->tt));
+    }
 }
 
 /*******************************************************************************
 * function name : doOneMove
-* input : -
+* input : Game *game
 * output : -
 * explanation : execute one move of gmaeplay.
 *******************************************************************************/
-void doOneMove() {
+void doOneMove(Game *game) {
+    long long start, chosen;
+    int moveNumber = game->pos.ply + 1;
     int x, y;
-    MoveMode m;
-    int oppColor = (curPlayer == BLACK) ? WHITE:BLACK;
-    printf("Please choose a square\n");
-    do {
-        scanf("\n[%d,%d]", &x, &y);
 
-        m = checkMove(x, y, curPlayer, TRUE);
-        if (m == NO_SUCH_SQUARE) {
-            printf("No such square\n");
-        } else if (m == INVALID_SQUARE) {
-            printf("This square is invalid\n");
-        } else {
-            // valid move
+    // no legal move - pass the turn
+    if (game->pos.sideToMove != game->curPlayer) {
+        report(game, "No legal moves, passing the turn\n");
+        sendPassToSharedMemory(game, nowNs());
+        return;
+    }
+
+    start = nowNs();
+    if (game->computer) {
+        searchMove(game, &x, &y);
+    } else if (game->scripted) {
+        scriptMove(game, &x, &y);
+    } else {
+        readMove(game, &x, &y);
+    }
+    chosen = nowNs();
+    game->clock += (uint32_t) ((chosen - start) / 1000000);
+
+    // valid move
+    printBoard(game);
+    // check if the game is over, the state goes with the move
+    game->gameState = checkEndGame(game);
+    sendMoveToSharedMemory(game, x, y, moveNumber, chosen);
+}
+
+/*******************************************************************************
+* function name : printResult
+* input : EndMode result
+* output : -
+* explanation : -
+*******************************************************************************/
+void printResult(EndMode result) {
+    switch (result) {
+        case WHITE_WIN: printf("Winning player: White\n");
             break;
+        case BLACK_WIN: printf("Winning player: Black\n");
+            break;
+        case DRAW:      printf("No winning player\n");
+            break;
+        default:        break;
+    }
+}
+
+/*******************************************************************************
+* function name : replayGame
+* input : Game *game, const int moves[], int n
+* output : the result, NO_END if the game isn't over, -1 on an illegal move
+* explanation : play the moves of one game on the board of game, checked
+*               the same way as a script.
+*******************************************************************************/
+int replayGame(Game *game, const int moves[], int n) {
+    const char *why;
+
+    initBoard(game);
+    if (checkMoves(&game->pos, moves, n, &why) < n) {
+        return -1;
+    }
+
+    game->gameState = checkEndGame(game);
+    return game->gameState;
+}
+
+/*******************************************************************************
+* function name : replayGames
+* input : Game *game, const char *path
+* output : the result of the last game, -1 if any game had an illegal move
+* explanation : replay every line of path as a game, without a server. the
+*               final board and result of each game are printed, or only the
+*               totals when quiet.
+*******************************************************************************/
+int replayGames(Game *game, const char *path) {
+    char *text = readAll(path);
+    const char *s = text;
+    int moves[MAX_PLIES];
+    // games by result, counts[0] for the illegal ones
+    long counts[NO_END + 1] = {0};
+    int line = 0, last = NO_END;
+
+    while (*s) {
+        int n = parseMoveLine(&s, moves, MAX_PLIES);
+
+        line++;
+        if (n == 0) {
+            continue;
         }
 
-        printf("Please choose another square\n");
-    } while (TRUE);
+        last = n < 0 ? -1 : replayGame(game, moves, n);
+        counts[last < 0 ? 0 : last]++;
+        if (last < 0) {
+            fprintf(stderr, "%s:%d: illegal game\n", path, line);
+            continue;
+        }
 
-    // valid move
-    printBoard();
-    sendMoveToSharedMemory(curPlayer, x, y);
-    // check if the opponent has moves
-    gameState = checkEndGame(oppColor);
+        if (!game->quiet) {
+            printf("Game on line %d:\n", line);
+            printBoard(game);
+            if (last == NO_END) {
+                printf("The game isn't over\n");
+            }
+            printResult(last);
+        }
+    }
+
+    printf("%ld games: %ld black wins, %ld white wins, %ld draws, "
+           "%ld unfinished, %ld illegal\n",
+           counts[BLACK_WIN] + counts[WHITE_WIN] + counts[DRAW] +
+           counts[NO_END] + counts[0], counts[BLACK_WIN], counts[WHITE_WIN],
+           counts[DRAW], counts[NO_END], counts[0]);
+
+    free(text);
+    return counts[0] ? -1 : last;
 }
 
 /*******************************************************************************
-* function name : start
-* input : int signum
+* function name : joinServer
+* input : int *shmFD, int *serverFD
+* output : our game's slot
+* explanation : connect to the server and wait until it pairs us with
+*               another player. the server knows our pid from the socket,
+*               and sends the fd of its shared memory with the answer. the
+*               connection stays open until we leave the game - the server
+*               takes it closing before that for our death.
+*******************************************************************************/
+uint32_t joinServer(int *shmFD, int *serverFD) {
+    char control[CMSG_SPACE(sizeof(int))];
+    struct sockaddr_un addr;
+    struct msghdr msg;
+    struct cmsghdr *cmsg;
+    struct iovec iov;
+    JoinReply reply;
+    ssize_t n;
+    int fd;
+
+    if ((fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0)) < 0) {
+        exitWithError("socket error");
+    }
+
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    strncpy(addr.sun_path, SERVER_SOCKET, sizeof(addr.sun_path) - 1);
+    if (connect(fd, (struct sockaddr *) &addr, sizeof(addr)) < 0) {
+        exitWithError("connect error");
+    }
+
+    iov.iov_base = &reply;
+    iov.iov_len = sizeof(reply);
+    memset(&msg, 0, sizeof(msg));
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+    msg.msg_control = control;
+    msg.msg_controllen = sizeof(control);
+
+    // the reply is sent whole in one message
+    while ((n = recvmsg(fd, &msg, MSG_CMSG_CLOEXEC)) < 0 && errno == EINTR) {
+    }
+    if (n != sizeof(reply)) {
+        // the server went away before pairing us
+        exitWithError("server closed the connection");
+    }
+
+    cmsg = CMSG_FIRSTHDR(&msg);
+    if (!cmsg || cmsg->cmsg_level != SOL_SOCKET || cmsg->cmsg_type != SCM_RIGHTS) {
+        fprintf(stderr, "no shared memory from the server\n");
+        exit(-1);
+    }
+    memcpy(shmFD, CMSG_DATA(cmsg), sizeof(int));
+    *serverFD = fd;
+
+    if (reply.version != ARENA_VERSION) {
+        fprintf(stderr, "server version %u, expected %u\n", reply.version,
+                ARENA_VERSION);
+        exit(-1);
+    }
+
+    return reply.slot;
+}
+
+/*******************************************************************************
+* function name : usage
+* input : const char *name - argv[0]
 * output : -
-* explanation : wake up function after pause.
+* explanation : write the usage to stderr and exit with code -1
 *******************************************************************************/
-void start(int signum) {
-    // do nothing - just wake up from pause
-    //printf("%d\n", getpid());
+void usage(const char *name) {
+    fprintf(stderr, "usage: %s [-a] [-t milliseconds] [-m megabytes] "
+            "[-j threads] [-e empties] [-B book] [-w weights] [-q] "
+            "[-d] [-i moves] [-r games]\n", name);
+    exit(-1);
 }
 
 /*******************************************************************************
 * function name : main
 * input : int argc, char **argv
-* output : 0
+* output : 0, with -i or -r the result of the game (-1 for an illegal one)
 * explanation : main function
 *******************************************************************************/
 int main(int argc, char **argv) {
-    int x,y;
-    int fifoFD;
-    char buffer[20] = {0};
-    struct sigaction sigUserHandler;
-    key_t key;
-    int shmid;
+    Game game;
+    struct stat st;
+    int shmFD, serverFD;
     pid_t pid;
-    struct shmid_ds ds;
-
-    sigset_t blocked;
+    int opt, stage;
+    const char *bookPath = NULL;
+    const char *weightsPath = NULL;
+    const char *scriptPath = NULL;
+    const char *replayPath = NULL;
+
+    // human player by default, -a for a computer player, -t for its time
+    game.computer = FALSE;
+    game.moveTime = DEFAULT_MOVE_TIME;
+    game.ttSize = DEFAULT_TT_SIZE;
+    game.threads = 1;
+    game.endgameEmpties = -1;
+    game.quiet = FALSE;
+    game.diff = FALSE;
+    game.script = NULL;
+    while ((opt = getopt(argc, argv, "at:m:j:e:B:w:qdi:r:")) != -1) {
+        switch (opt) {
+            case 'a': game.computer = TRUE;
+                break;
+            case 't': game.moveTime = atoi(optarg);
+                break;
+            case 'm': game.ttSize = atoi(optarg);
+                break;
+            case 'j': game.threads = atoi(optarg);
+                break;
+            case 'e': game.endgameEmpties = atoi(optarg);
+                break;
+            case 'B': bookPath = optarg;
+                break;
+            case 'w': weightsPath = optarg;
+                break;
+            case 'q': game.quiet = TRUE;
+                break;
+            case 'd': game.diff = TRUE;
+                break;
+            case 'i': scriptPath = optarg;
+                break;
+            case 'r': replayPath = optarg;
+                break;
+            default:
+                usage(argv[0]);
+        }
+    }
 
-    sigemptyset(&blocked);
-    // set handler for SIGALRM
-    sigUserHandler.sa_handler = start;
-    sigUserHandler.sa_mask = blocked;
-    sigUserHandler.sa_flags = 0;
+    // the computer chooses its own moves, it can't follow a script
+    if (game.computer && scriptPath) {
+        fprintf(stderr, "-a and -i can't be used together\n");
+        usage(argv[0]);
+    }
+    game.scripted = scriptPath ? TRUE : FALSE;
+
+    // as many empties as the solver usually finishes in the move's time
+    if (game.endgameEmpties < 0) {
+        long ms;
+        game.endgameEmpties = ENDGAME_EMPTIES;
+        for (ms = ENDGAME_TIME * 8; ms <= game.moveTime; ms *= 8) {
+            game.endgameEmpties += 2;
+        }
+    }
 
-    if ((sigaction(SIGUSR1, &sigUserHandler, NULL)) < 0) {
-        exitWithError("sigaction error");
+    // scripted output isn't read by a person, it goes out in big writes
+    if (game.quiet || scriptPath || replayPath) {
+        setvbuf(stdout, NULL, _IOFBF, READ_CHUNK);
     }
 
-    // create key
-    key = ftok("ex31.c", 'k');
-    if (((key_t) - 1) == key) {
-        exitWithError("ftok error");
+    // replay needs no server and no opponent
+    if (replayPath) {
+        return replayGames(&game, replayPath);
     }
 
-    // open the fifo for communication
-    if ((fifoFD = open("fifo_clientTOserver", O_WRONLY)) < 0) {
-        exitWithError("fifo error");
+    // a bad script stops us before we take a place on the server
+    if (scriptPath) {
+        loadScript(&game, scriptPath);
     }
 
-    // assign pid
-    pid = getpid();
+    // the computer player keeps its table and threads between moves
+    if (game.computer) {
+        TransTable *tt = NULL;
+
+        // without a weights file poolInit sets the default weights
+        if (weightsPath && evalLoad(weightsPath) < 0) {
+            exitWithError("weights error");
+        }
 
-    // send pid to server
-    if ((write(fifoFD, &pid, sizeof(pid_t))) < 0) {
-        exitWithError("write error");
+        if (game.ttSize > 0) {
+            if (ttInit(&game.tt, game.ttSize) < 0) {
+                exitWithError("transposition table error");
+            }
+            tt = &game.tt;
+        }
+
+        if (poolInit(&game.pool, game.threads, tt) < 0) {
+            exitWithError("search threads error");
+        }
     }
 
-    // close the fifo
-    if ((close(fifoFD)) < 0) {
-        exitWithError("close error");
+    // the book is mapped, nothing is read until a lookup
+    game.book.map = NULL;
+    if (game.computer && bookPath && bookOpen(&game.book, bookPath) < 0) {
+        exitWithError("book error");
     }
 
-    // wait for SIGUSR1
-    pause();
+    // register with the server, it answers once we have an opponent
+    pid = getpid();
+    game.slot = joinServer(&shmFD, &serverFD);
 
-    // get the shmid by key
-    if ((shmid = shmget(key, MEM_SIZE, 0644 | IPC_CREAT)) < 0) {
-        exitWithError("shmget error");
+    // the size of the memory comes from the memory itself
+    if (fstat(shmFD, &st) < 0) {
+        exitWithError("fstat error");
     }
+    game.mapSize = st.st_size;
 
     // attach to the shared memory
-    sMBuf = (char *) shmat( shmid, NULL, 0);
-    if (((char *) - 1) == sMBuf) {
-        exitWithError("shmat error");
+    game.arena = mmap(NULL, game.mapSize, PROT_READ | PROT_WRITE, MAP_SHARED,
+                      shmFD, 0);
+    if (game.arena == MAP_FAILED) {
+        exitWithError("mmap error");
     }
+    close(shmFD);
 
-    // check to determine which player I am
-    if (shmctl(shmid, IPC_STAT, &ds) == -1) {
-        exitWithError("shmctl error");
+    if (game.mapSize < sizeof(GameArena) || game.arena->version != ARENA_VERSION ||
+        arenaSize(game.arena->slots) > game.mapSize || game.slot >= game.arena->slots) {
+        fprintf(stderr, "bad shared memory from the server\n");
+        exit(-1);
     }
+    game.shared = arenaSlot(game.arena, game.slot);
 
-    // determine player
-    if (ds.shm_nattch == 2) {
-        curPlayer = BLACK;
-    } else if (ds.shm_nattch == 3) {
-        curPlayer = WHITE;
+    // the server wrote the colours before answering us
+    if (loadWord(&game.shared->blackPid) == (uint32_t) pid) {
+        game.curPlayer = BLACK;
+    } else if (loadWord(&game.shared->whitePid) == (uint32_t) pid) {
+        game.curPlayer = WHITE;
+    } else {
+        fprintf(stderr, "not a player of this game\n");
+        exit(-1);
     }
 
+    // rings[0] carries black's moves, rings[1] white's
+    game.out = &game.shared->rings[game.curPlayer == BLACK ? 0 : 1];
+    game.in = &game.shared->rings[game.curPlayer == BLACK ? 1 : 0];
+    game.clock = 0;
+    memset(game.latency, 0, sizeof(game.latency));
+
+    // tell the server we are in
+    addWord(&game.shared->attached, 1);
+
     // initialize game
-    initBoard();
+    initBoard(&game);
 
     // first play
-    if (curPlayer == BLACK) {
-        printBoard();
-        doOneMove();
+    if (game.curPlayer == BLACK) {
+        printBoard(&game);
+        doOneMove(&game);
     }
 
     // game loop
     while (TRUE) {
+        MoveEntry m;
+
         // current player move
-        if (charToPlayer(sMBuf[0]) != curPlayer) {
-            getMoveFromSharedMemory();
-            if (gameState != NO_END) break;
-            printBoard();
-            doOneMove();
-            if (gameState != NO_END) break;
+        if (ringPop(game.in, &m)) {
+            // the other player died, the game has no result
+            if (m.state == MOVE_ABANDONED) {
+                fprintf(stderr, "The other player is gone, no result\n");
+                game.gameState = NO_END;
+                break;
+            }
+            getMoveFromSharedMemory(&game, &m, nowNs());
+            if (game.gameState != NO_END) break;
+            printBoard(&game);
+            doOneMove(&game);
+            if (game.gameState != NO_END) break;
         } else {
-            // wait for the other player to play
-            printf("Waiting for the other player to make a move\n");
-            sleep(1);
+            // sleep until the other player writes his move
+            report(&game, "Waiting for the other player to make a move\n");
+            fflush(stdout);
+            ringWait(game.in);
         }
     }
 
-    // notify server on game end
-    if (sMBuf[6] != 'e') {
-        sleep(2);
-        sMBuf[6] = 'e';
+    // both players know the result, the first to get here writes it
+    publishOnce(&game.shared->result, game.gameState);
 
-        // print end results
-        switch (gameState) {
-            case WHITE_WIN: printf("Winning player: White\n");
-                sMBuf[7] = 'w';
-                break;
-            case BLACK_WIN: printf("Winning player: Black\n");
-                sMBuf[7] = 'b';
-                break;
-            case DRAW:      printf("No winning player\n");
-                sMBuf[7] = 'd';
-            default:        break;
-        }
-    } else {
-        switch (sMBuf[7]) {
-            case 'w': printf("Winning player: White\n");
-                break;
-            case 'b': printf("Winning player: Black\n");
-                break;
-            case 'd': printf("No winning player\n");
-                break;
-            default:
-                break;
-        }
+    // print end results
+    printResult(game.gameState);
+
+    // our latencies go to the server's totals before we leave
+    for (stage = 0; stage < LATENCY_STAGES; stage++) {
+        latencyMerge(&game.arena->latency[stage], &game.latency[stage]);
     }
 
+    // done with the slot, the server may give it to another game
+    gameLeave(game.arena, game.slot, game.curPlayer == BLACK ? 0 : 1);
+    close(serverFD);
+
     // detach from the shared memory
-    if ((shmdt(sMBuf)) <0 ) {
-        exitWithError("shmdt error");
+    if ((munmap(game.arena, game.mapSize)) < 0) {
+        exitWithError("munmap error");
+    }
+
+    if (game.computer) {
+        if (game.pool.tt) {
+            ttFree(&game.tt);
+        }
+        poolFree(&game.pool);
+        bookClose(&game.book);
+        evalFree();
     }
+    free(game.script);
 
-    return 0;
+    // a script can tell how its game ended
+    return scriptPath ? (int) game.gameState : 0;
 }
 
 
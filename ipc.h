@@ -0,0 +1,427 @@
+/*
+ * Student name : Or Zipori
+ * Student : 302933833
+ * Course Exercise Group : 03
+ * Exercise Name : ex3
+ */
+#ifndef IPC_H
+#define IPC_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <errno.h>
+#include <unistd.h>
+#include <sys/syscall.h>
+#include <linux/futex.h>
+#include "latency.h"
+#include "timer.h"
+
+// version of the GameArena layout, raise it on any change
+#define ARENA_VERSION 6
+#define SQUARE_NONE 0xff
+#define CACHE_LINE 64
+#define SLOT_NONE 0xffffffffu
+// the state of the entry the server puts in the ring of a player that died
+#define MOVE_ABANDONED 0xff
+
+typedef enum {SLOT_FREE = 0, SLOT_IN_USE} SlotState;
+
+// the server's listening socket, and what it answers a player it paired
+#define SERVER_SOCKET "ex31.sock"
+
+typedef struct {
+    uint32_t version;
+    uint32_t slot;
+} JoinReply;
+
+/*
+ * a move as it goes from one player to the other. moveNumber counts the
+ * passes too, clock is the total thinking time of the mover so far and
+ * ponder the reply it expects (SQUARE_NONE if it has no idea). the times
+ * are nowNs, one clock for all the processes of the host.
+ */
+typedef struct {
+    uint32_t moveNumber;
+    // SQUARE_NONE for a pass
+    uint8_t square;
+    // the EndMode of the game after the move, MOVE_ABANDONED for the
+    // server's word that the mover is gone
+    uint8_t state;
+    uint8_t ponder;
+    uint8_t unused;
+    uint32_t clock;
+    uint32_t unused2;
+    // when the move was chosen and when it went into the ring
+    uint64_t chosenNs;
+    uint64_t publishedNs;
+} MoveEntry;
+
+/*
+ * the moves of one player, single producer (the player) and single
+ * consumer (its opponent). head is the number of moves written and tail the
+ * number read, each on a line of its own, the reader sleeps on head and a
+ * writer with a full ring on tail. no game has more than 60 moves and
+ * passes of one player, so the ring never wraps and keeps the whole game.
+ */
+#define RING_SIZE 64
+
+typedef struct {
+    uint32_t head __attribute__((aligned(CACHE_LINE)));
+    uint32_t tail __attribute__((aligned(CACHE_LINE)));
+    MoveEntry entries[RING_SIZE] __attribute__((aligned(CACHE_LINE)));
+} MoveRing;
+
+/*
+ * one game in the shared memory. every game starts on a cache line of its
+ * own, so games played on different cores don't slow each other down.
+ */
+typedef struct {
+    // 0 while the game is on, then its result (an EndMode)
+    uint32_t result;
+    // the pids of the players, written by the server before it answers
+    // them, each player finds its colour by its pid
+    uint32_t blackPid;
+    uint32_t whitePid;
+    // raised by each player once it is attached and knows its colour
+    uint32_t attached;
+    // a bit for each player once it is done with the slot, 1 black 2 white.
+    // the server leaves for a player that died
+    uint32_t left;
+    // SlotState, and the number of the game the slot holds
+    uint32_t slotState;
+    uint32_t gameNumber;
+    // next slot in the free or finished list
+    uint32_t next;
+    // when the second player left, for the server's reap latency
+    uint64_t endedNs;
+    // rings[0] carries black's moves, rings[1] white's
+    MoveRing rings[2];
+} __attribute__((aligned(CACHE_LINE))) SharedGame;
+
+/*
+ * the shared memory segment: this header, then the game slots. free slots
+ * and finished games (both players left, the server has not looked at it
+ * yet) are kept in two lock free stacks. a stack head is the top slot + 1
+ * in the low half and a tag in the high half, raised on every change so a
+ * slot popped and pushed back between the read and the swap is noticed.
+ * the heads are in lines of their own, away from the games.
+ */
+typedef struct {
+    // set by the server, checked by the players
+    uint32_t version;
+    uint32_t slots;
+    // games handed out so far
+    uint32_t games;
+    uint64_t freeList __attribute__((aligned(CACHE_LINE)));
+    uint64_t finishedList __attribute__((aligned(CACHE_LINE)));
+    // raised when a game is finished
+    uint32_t finishedEvents;
+    // the latencies of all the games, each player adds its own as it leaves
+    LatencyHistogram latency[LATENCY_STAGES] __attribute__((aligned(CACHE_LINE)));
+} __attribute__((aligned(CACHE_LINE))) GameArena;
+
+/*******************************************************************************
+* function name : futexWait
+* input : uint32_t *word, uint32_t expected
+* output : -
+* explanation : sleep while *word is expected. may return early (a signal
+*               or a spurious wake up), the caller checks again.
+*******************************************************************************/
+static inline void futexWait(uint32_t *word, uint32_t expected) {
+    // not a private futex - the word is shared between processes
+    if (syscall(SYS_futex, word, FUTEX_WAIT, expected, NULL, NULL, 0) < 0 &&
+        errno != EAGAIN && errno != EINTR) {
+        perror("futex wait error");
+    }
+}
+
+/*******************************************************************************
+* function name : futexWake
+* input : uint32_t *word
+* output : -
+* explanation : wake everyone sleeping on word.
+*******************************************************************************/
+static inline void futexWake(uint32_t *word) {
+    if (syscall(SYS_futex, word, FUTEX_WAKE, INT32_MAX, NULL, NULL, 0) < 0) {
+        perror("futex wake error");
+    }
+}
+
+/*******************************************************************************
+* function name : loadWord, publishWord
+* input : uint32_t *word (, uint32_t value)
+* output : the value of word / -
+* explanation : publishWord makes everything written before it visible to
+*               a process that reads the new value with loadWord, then
+*               wakes the sleepers.
+*******************************************************************************/
+static inline uint32_t loadWord(uint32_t *word) {
+    return __atomic_load_n(word, __ATOMIC_ACQUIRE);
+}
+
+static inline void publishWord(uint32_t *word, uint32_t value) {
+    __atomic_store_n(word, value, __ATOMIC_RELEASE);
+    futexWake(word);
+}
+
+/*******************************************************************************
+* function name : ringPush
+* input : MoveRing *ring, const MoveEntry *e
+* output : -
+* explanation : add a move and wake the reader. sleeps while the ring is
+*               full.
+*******************************************************************************/
+static inline void ringPush(MoveRing *ring, const MoveEntry *e) {
+    uint32_t head = __atomic_load_n(&ring->head, __ATOMIC_RELAXED), tail;
+
+    while (head - (tail = loadWord(&ring->tail)) >= RING_SIZE) {
+        futexWait(&ring->tail, tail);
+    }
+
+    ring->entries[head % RING_SIZE] = *e;
+    publishWord(&ring->head, head + 1);
+}
+
+/*******************************************************************************
+* function name : ringPop
+* input : MoveRing *ring, MoveEntry *e
+* output : 1 if a move was read into e, 0 if there is none
+* explanation : take the oldest unread move.
+*******************************************************************************/
+static inline int ringPop(MoveRing *ring, MoveEntry *e) {
+    uint32_t tail = __atomic_load_n(&ring->tail, __ATOMIC_RELAXED);
+
+    if (tail == loadWord(&ring->head)) {
+        return 0;
+    }
+
+    *e = ring->entries[tail % RING_SIZE];
+    // wakes the writer if the ring was full
+    publishWord(&ring->tail, tail + 1);
+    return 1;
+}
+
+/*******************************************************************************
+* function name : ringWait
+* input : MoveRing *ring
+* output : -
+* explanation : sleep until there is a move to read.
+*******************************************************************************/
+static inline void ringWait(MoveRing *ring) {
+    uint32_t tail = __atomic_load_n(&ring->tail, __ATOMIC_RELAXED);
+
+    // returns at once if a move came after ringPop looked
+    futexWait(&ring->head, tail);
+}
+
+/*******************************************************************************
+* function name : gameHistory
+* input : SharedGame *game, MoveEntry moves[]
+* output : number of moves of the game so far
+* explanation : both rings merged in the order of the moves. moves must
+*               hold 2 * RING_SIZE entries.
+*******************************************************************************/
+static inline int gameHistory(SharedGame *game, MoveEntry moves[]) {
+    MoveRing *black = &game->rings[0], *white = &game->rings[1];
+    uint32_t blackMoves = loadWord(&black->head), whiteMoves = loadWord(&white->head);
+    uint32_t b = 0, w = 0;
+    int n = 0;
+
+    if (blackMoves > RING_SIZE) blackMoves = RING_SIZE;
+    if (whiteMoves > RING_SIZE) whiteMoves = RING_SIZE;
+
+    // the server's word that a player died is not a move
+    if (blackMoves && black->entries[blackMoves - 1].state == MOVE_ABANDONED) {
+        blackMoves--;
+    }
+    if (whiteMoves && white->entries[whiteMoves - 1].state == MOVE_ABANDONED) {
+        whiteMoves--;
+    }
+
+    while (b < blackMoves || w < whiteMoves) {
+        if (w == whiteMoves ||
+            (b < blackMoves && black->entries[b].moveNumber < white->entries[w].moveNumber)) {
+            moves[n++] = black->entries[b++];
+        } else {
+            moves[n++] = white->entries[w++];
+        }
+    }
+
+    return n;
+}
+
+/*******************************************************************************
+* function name : addWord
+* input : uint32_t *word, uint32_t delta
+* output : -
+* explanation : add delta to word and wake the sleepers.
+*******************************************************************************/
+static inline void addWord(uint32_t *word, uint32_t delta) {
+    __atomic_add_fetch(word, delta, __ATOMIC_RELEASE);
+    futexWake(word);
+}
+
+/*******************************************************************************
+* function name : publishOnce
+* input : uint32_t *word, uint32_t value
+* output : 1 if value was stored, 0 if the word was already set
+* explanation : store value only if the word is still 0, and wake the
+*               sleepers.
+*******************************************************************************/
+static inline int publishOnce(uint32_t *word, uint32_t value) {
+    uint32_t expected = 0;
+
+    if (!__atomic_compare_exchange_n(word, &expected, value, 0,
+                                     __ATOMIC_RELEASE, __ATOMIC_RELAXED)) {
+        return 0;
+    }
+
+    futexWake(word);
+    return 1;
+}
+
+/*******************************************************************************
+* function name : arenaSize
+* input : uint32_t slots
+* output : bytes of an arena of slots games
+* explanation : -
+*******************************************************************************/
+static inline size_t arenaSize(uint32_t slots) {
+    return sizeof(GameArena) + (size_t) slots * sizeof(SharedGame);
+}
+
+/*******************************************************************************
+* function name : arenaSlot
+* input : GameArena *arena, uint32_t slot
+* output : the game in slot
+* explanation : -
+*******************************************************************************/
+static inline SharedGame *arenaSlot(GameArena *arena, uint32_t slot) {
+    return (SharedGame *) (arena + 1) + slot;
+}
+
+/*******************************************************************************
+* function name : listPush
+* input : GameArena *arena, uint64_t *list, uint32_t slot
+* output : -
+* explanation : push slot on a lock free stack.
+*******************************************************************************/
+static inline void listPush(GameArena *arena, uint64_t *list, uint32_t slot) {
+    uint64_t head = __atomic_load_n(list, __ATOMIC_RELAXED), next;
+
+    do {
+        __atomic_store_n(&arenaSlot(arena, slot)->next, (uint32_t) head - 1,
+                         __ATOMIC_RELAXED);
+        next = ((head >> 32) + 1) << 32 | (slot + 1);
+    } while (!__atomic_compare_exchange_n(list, &head, next, 1,
+                                          __ATOMIC_RELEASE, __ATOMIC_RELAXED));
+}
+
+/*******************************************************************************
+* function name : listPop
+* input : GameArena *arena, uint64_t *list
+* output : the top slot, SLOT_NONE if the stack is empty
+* explanation : pop a lock free stack.
+*******************************************************************************/
+static inline uint32_t listPop(GameArena *arena, uint64_t *list) {
+    uint64_t head = __atomic_load_n(list, __ATOMIC_ACQUIRE), next;
+    uint32_t slot;
+
+    do {
+        if ((uint32_t) head == 0) {
+            return SLOT_NONE;
+        }
+
+        slot = (uint32_t) head - 1;
+        // next may change under us if slot was popped meanwhile, then the
+        // tag changed too and the swap fails
+        next = ((head >> 32) + 1) << 32 |
+               (uint32_t) (__atomic_load_n(&arenaSlot(arena, slot)->next,
+                                           __ATOMIC_RELAXED) + 1);
+    } while (!__atomic_compare_exchange_n(list, &head, next, 1,
+                                          __ATOMIC_ACQUIRE, __ATOMIC_ACQUIRE));
+
+    return slot;
+}
+
+/*******************************************************************************
+* function name : arenaInit
+* input : GameArena *arena, uint32_t slots
+* output : -
+* explanation : an arena of free slots, the memory is already zero.
+*******************************************************************************/
+static inline void arenaInit(GameArena *arena, uint32_t slots) {
+    uint32_t i;
+
+    arena->version = ARENA_VERSION;
+    arena->slots = slots;
+
+    // lowest slot on top
+    for (i = slots; i > 0; i--) {
+        listPush(arena, &arena->freeList, i - 1);
+    }
+}
+
+/*******************************************************************************
+* function name : arenaAlloc
+* input : GameArena *arena, uint32_t blackPid, uint32_t whitePid
+* output : the slot of the new game, SLOT_NONE if all the slots are taken
+* explanation : take a free slot for a game of the two players.
+*******************************************************************************/
+static inline uint32_t arenaAlloc(GameArena *arena, uint32_t blackPid,
+                                  uint32_t whitePid) {
+    SharedGame *game;
+    uint32_t slot;
+
+    if ((slot = listPop(arena, &arena->freeList)) == SLOT_NONE) {
+        return SLOT_NONE;
+    }
+
+    // the rings start empty, their entries are overwritten as they are used
+    game = arenaSlot(arena, slot);
+    game->rings[0].head = game->rings[0].tail = 0;
+    game->rings[1].head = game->rings[1].tail = 0;
+    game->result = 0;
+    game->blackPid = blackPid;
+    game->whitePid = whitePid;
+    game->attached = 0;
+    game->left = 0;
+    game->gameNumber = __atomic_add_fetch(&arena->games, 1, __ATOMIC_RELAXED);
+    __atomic_store_n(&game->slotState, SLOT_IN_USE, __ATOMIC_RELEASE);
+
+    return slot;
+}
+
+/*******************************************************************************
+* function name : arenaFree
+* input : GameArena *arena, uint32_t slot
+* output : -
+* explanation : give back the slot of a finished game.
+*******************************************************************************/
+static inline void arenaFree(GameArena *arena, uint32_t slot) {
+    __atomic_store_n(&arenaSlot(arena, slot)->slotState, SLOT_FREE,
+                     __ATOMIC_RELAXED);
+    listPush(arena, &arena->freeList, slot);
+}
+
+/*******************************************************************************
+* function name : gameLeave
+* input : GameArena *arena, uint32_t slot, int ring - 0 black, 1 white
+* output : -
+* explanation : a player is done with its game. the second to leave hands
+*               the game to the server.
+*******************************************************************************/
+static inline void gameLeave(GameArena *arena, uint32_t slot, int ring) {
+    SharedGame *game = arenaSlot(arena, slot);
+    uint32_t bit = 1u << ring;
+    uint32_t before = __atomic_fetch_or(&game->left, bit, __ATOMIC_ACQ_REL);
+
+    if (!(before & bit) && (before | bit) == 3) {
+        // the push makes it visible to the server
+        game->endedNs = nowNs();
+        listPush(arena, &arena->finishedList, slot);
+        addWord(&arena->finishedEvents, 1);
+    }
+}
+
+#endif
@@ -0,0 +1,579 @@
+/*
+ * Student name : Or Zipori
+ * Student : 302933833
+ * Course Exercise Group : 03
+ * Exercise Name : ex3
+ */
+// sched_setaffinity and the cpu sets
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <sched.h>
+#include <time.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+#include <sys/wait.h>
+#include <sys/socket.h>
+#include <sys/eventfd.h>
+#include "ipc.h"
+
+#define DEFAULT_ROUNDS 100000
+#define DEFAULT_WARMUP 1000
+// microseconds between two looks of the sleep transport
+#define DEFAULT_SLEEP 50
+// checks of the spin transport before it gives the core away
+#define SPIN_CHECKS 1024
+
+/*
+ * what the two processes share. box[side] is the message on its way to
+ * side, seq[side] counts the messages put in it. each is on a line of its
+ * own so the two directions don't share a cache line.
+ */
+typedef struct {
+    MoveEntry box[2] __attribute__((aligned(CACHE_LINE)));
+    uint32_t seq0 __attribute__((aligned(CACHE_LINE)));
+    uint32_t seq1 __attribute__((aligned(CACHE_LINE)));
+} Shared;
+
+/*
+ * one end of the ping pong. side 0 is the parent, it sends first and
+ * times the round trips, side 1 the child that answers.
+ */
+typedef struct {
+    int side;
+    pid_t peer;
+    Shared *shared;
+    // messages put in the peer's box and seen in ours so far
+    uint32_t sent;
+    uint32_t seen;
+    // the fds of the fifo and socket transports
+    int readFD;
+    int writeFD;
+    // the ends of the socket pair, and the eventfds of each side
+    int socketFD[2];
+    int eventFD[2];
+    int sleepUs;
+} Endpoint;
+
+/*
+ * a way to move a message from one process to the other. setup runs once
+ * before the fork, open in each process after it.
+ */
+typedef struct {
+    const char *name;
+    void (*setup)(Endpoint *e);
+    void (*open)(Endpoint *e);
+    void (*send)(Endpoint *e, const MoveEntry *m);
+    void (*receive)(Endpoint *e, MoveEntry *m);
+    void (*close)(Endpoint *e);
+} Transport;
+
+// the fifos of the fifo transport, made by setup
+#define FIFO_TEMPLATE "/tmp/ipcbench.XXXXXX"
+static char fifoDir[sizeof(FIFO_TEMPLATE)];
+static char fifoPath[2][sizeof(FIFO_TEMPLATE) + 8];
+
+/*******************************************************************************
+* function name : exitWithError
+* input : message
+* output : -
+* explanation : write to stderr the message and exit with code -1
+*******************************************************************************/
+void exitWithError(char *msg) {
+    perror(msg);
+    exit(-1);
+}
+
+/*******************************************************************************
+* function name : seqOf
+* input : Endpoint *e, int side
+* output : the message counter of side's box
+* explanation : -
+*******************************************************************************/
+uint32_t *seqOf(Endpoint *e, int side) {
+    return side ? &e->shared->seq1 : &e->shared->seq0;
+}
+
+/*******************************************************************************
+* function name : readAll, writeAll
+* input : int fd, void *buf, size_t size
+* output : -
+* explanation : move exactly size bytes, a stream may cut them.
+*******************************************************************************/
+void readAll(int fd, void *buf, size_t size) {
+    while (size > 0) {
+        ssize_t n = read(fd, buf, size);
+        if (n <= 0) {
+            if (n < 0 && errno == EINTR) continue;
+            exitWithError("read error");
+        }
+        buf = (char *) buf + n;
+        size -= n;
+    }
+}
+
+void writeAll(int fd, const void *buf, size_t size) {
+    while (size > 0) {
+        ssize_t n = write(fd, buf, size);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            exitWithError("write error");
+        }
+        buf = (const char *) buf + n;
+        size -= n;
+    }
+}
+
+/*******************************************************************************
+* function name : noSetup, noOpen, noClose
+* input : Endpoint *e
+* output : -
+* explanation : for the transports that need nothing there.
+*******************************************************************************/
+void noSetup(Endpoint *e) { (void) e; }
+void noOpen(Endpoint *e) { (void) e; }
+void noClose(Endpoint *e) { (void) e; }
+
+/*******************************************************************************
+* function name : boxPut, boxTake
+* input : Endpoint *e, (const) MoveEntry *m
+* output : -
+* explanation : the message goes through the shared box, the transport
+*               only tells the other side it is there.
+*******************************************************************************/
+void boxPut(Endpoint *e, const MoveEntry *m) {
+    e->shared->box[!e->side] = *m;
+}
+
+void boxTake(Endpoint *e, MoveEntry *m) {
+    *m = e->shared->box[e->side];
+}
+
+/*
+ * signal - the box and SIGUSR1, like the first ex31/ex32. the signal is
+ * blocked and taken with sigwaitinfo, so there is no handler to run.
+ */
+void signalSetup(Endpoint *e) {
+    sigset_t set;
+
+    (void) e;
+    sigemptyset(&set);
+    sigaddset(&set, SIGUSR1);
+    if (sigprocmask(SIG_BLOCK, &set, NULL) < 0) {
+        exitWithError("sigprocmask error");
+    }
+}
+
+void signalSend(Endpoint *e, const MoveEntry *m) {
+    boxPut(e, m);
+    if (kill(e->peer, SIGUSR1) < 0) {
+        exitWithError("kill error");
+    }
+}
+
+void signalReceive(Endpoint *e, MoveEntry *m) {
+    sigset_t set;
+
+    sigemptyset(&set);
+    sigaddset(&set, SIGUSR1);
+    while (sigwaitinfo(&set, NULL) < 0) {
+        if (errno != EINTR) exitWithError("sigwaitinfo error");
+    }
+    boxTake(e, m);
+}
+
+/*
+ * fifo - a named fifo each way, like the first players' registration. the
+ * message itself goes through the fifo.
+ */
+void fifoSetup(Endpoint *e) {
+    int i;
+
+    (void) e;
+    // mkdtemp fills in the template, every run needs a new one
+    strcpy(fifoDir, FIFO_TEMPLATE);
+    if (!mkdtemp(fifoDir)) {
+        exitWithError("mkdtemp error");
+    }
+    for (i = 0; i < 2; i++) {
+        sprintf(fifoPath[i], "%s/%d", fifoDir, i);
+        if (mkfifo(fifoPath[i], 0600) < 0) {
+            exitWithError("mkfifo error");
+        }
+    }
+}
+
+void fifoOpen(Endpoint *e) {
+    // both open fifo 1 first, so neither waits for the other for ever
+    if (e->side == 0) {
+        e->writeFD = open(fifoPath[1], O_WRONLY);
+        e->readFD = open(fifoPath[0], O_RDONLY);
+    } else {
+        e->readFD = open(fifoPath[1], O_RDONLY);
+        e->writeFD = open(fifoPath[0], O_WRONLY);
+    }
+    if (e->readFD < 0 || e->writeFD < 0) {
+        exitWithError("fifo open error");
+    }
+}
+
+void streamSend(Endpoint *e, const MoveEntry *m) {
+    writeAll(e->writeFD, m, sizeof(*m));
+}
+
+void streamReceive(Endpoint *e, MoveEntry *m) {
+    readAll(e->readFD, m, sizeof(*m));
+}
+
+void streamClose(Endpoint *e) {
+    close(e->readFD);
+    if (e->writeFD != e->readFD) {
+        close(e->writeFD);
+    }
+}
+
+void fifoClose(Endpoint *e) {
+    streamClose(e);
+    if (e->side == 0) {
+        unlink(fifoPath[0]);
+        unlink(fifoPath[1]);
+        rmdir(fifoDir);
+    }
+}
+
+/*
+ * socket - a unix stream socket pair, like the server's registration.
+ */
+void socketSetup(Endpoint *e) {
+    int fds[2];
+
+    if (socketpair(AF_UNIX, SOCK_STREAM, 0, fds) < 0) {
+        exitWithError("socketpair error");
+    }
+    e->socketFD[0] = fds[0];
+    e->socketFD[1] = fds[1];
+}
+
+void socketOpen(Endpoint *e) {
+    e->readFD = e->writeFD = e->socketFD[e->side];
+    close(e->socketFD[!e->side]);
+}
+
+/*
+ * sleep - the box and a counter looked at every sleepUs, the way the first
+ * players waited for each other.
+ */
+void sleepSend(Endpoint *e, const MoveEntry *m) {
+    boxPut(e, m);
+    __atomic_store_n(seqOf(e, !e->side), ++e->sent, __ATOMIC_RELEASE);
+}
+
+void sleepReceive(Endpoint *e, MoveEntry *m) {
+    struct timespec ts = {0, e->sleepUs * 1000L};
+
+    while (__atomic_load_n(seqOf(e, e->side), __ATOMIC_ACQUIRE) == e->seen) {
+        nanosleep(&ts, NULL);
+    }
+    e->seen++;
+    boxTake(e, m);
+}
+
+/*
+ * spin - the same counter looked at without a pause. it is the fastest on
+ * two free cores, on one core the core is given away every SPIN_CHECKS
+ * looks or the peer could never run.
+ */
+void spinReceive(Endpoint *e, MoveEntry *m) {
+    int checks = 0;
+
+    while (__atomic_load_n(seqOf(e, e->side), __ATOMIC_ACQUIRE) == e->seen) {
+        if (++checks == SPIN_CHECKS) {
+            sched_yield();
+            checks = 0;
+        }
+    }
+    e->seen++;
+    boxTake(e, m);
+}
+
+/*
+ * futex - the counter, and a futex on it to sleep on, like the rings of
+ * the arena.
+ */
+void futexSend(Endpoint *e, const MoveEntry *m) {
+    boxPut(e, m);
+    publishWord(seqOf(e, !e->side), ++e->sent);
+}
+
+void futexReceive(Endpoint *e, MoveEntry *m) {
+    uint32_t *seq = seqOf(e, e->side);
+
+    while (loadWord(seq) == e->seen) {
+        futexWait(seq, e->seen);
+    }
+    e->seen++;
+    boxTake(e, m);
+}
+
+/*
+ * eventfd - the box and an eventfd for each side to sleep on.
+ */
+void eventSetup(Endpoint *e) {
+    if ((e->eventFD[0] = eventfd(0, 0)) < 0 || (e->eventFD[1] = eventfd(0, 0)) < 0) {
+        exitWithError("eventfd error");
+    }
+}
+
+void eventSend(Endpoint *e, const MoveEntry *m) {
+    boxPut(e, m);
+    if (eventfd_write(e->eventFD[!e->side], 1) < 0) {
+        exitWithError("eventfd_write error");
+    }
+}
+
+void eventReceive(Endpoint *e, MoveEntry *m) {
+    eventfd_t value;
+
+    while (eventfd_read(e->eventFD[e->side], &value) < 0) {
+        if (errno != EINTR) exitWithError("eventfd_read error");
+    }
+    boxTake(e, m);
+}
+
+void eventClose(Endpoint *e) {
+    close(e->eventFD[0]);
+    close(e->eventFD[1]);
+}
+
+/*
+ * sleep, spin and futex wait for the peer's counter to move past the
+ * messages already seen. the sides take turns, so there is never more
+ * than one message in a box.
+ */
+static const Transport transports[] = {
+    {"signal", signalSetup, noOpen, signalSend, signalReceive, noClose},
+    {"fifo", fifoSetup, fifoOpen, streamSend, streamReceive, fifoClose},
+    {"socket", socketSetup, socketOpen, streamSend, streamReceive, streamClose},
+    {"sleep", noSetup, noOpen, sleepSend, sleepReceive, noClose},
+    {"spin", noSetup, noOpen, sleepSend, spinReceive, noClose},
+    {"futex", noSetup, noOpen, futexSend, futexReceive, noClose},
+    {"eventfd", eventSetup, noOpen, eventSend, eventReceive, eventClose},
+};
+#define TRANSPORTS (int) (sizeof(transports) / sizeof(transports[0]))
+
+/*******************************************************************************
+* function name : pinTo
+* input : int cpu - -1 for any
+* output : -
+* explanation : keep this process on one cpu.
+*******************************************************************************/
+void pinTo(int cpu) {
+    cpu_set_t set;
+
+    if (cpu < 0) {
+        return;
+    }
+
+    CPU_ZERO(&set);
+    CPU_SET(cpu, &set);
+    if (sched_setaffinity(0, sizeof(set), &set) < 0) {
+        exitWithError("sched_setaffinity error");
+    }
+}
+
+/*******************************************************************************
+* function name : runTransport
+* input : const Transport *t, int rounds, int warmup, int cpus[2], int sleepUs
+* output : -
+* explanation : fork a child that answers every message, and time rounds
+*               round trips after warmup untimed ones.
+*******************************************************************************/
+void runTransport(const Transport *t, int rounds, int warmup, int cpus[2],
+                  int sleepUs) {
+    static LatencyHistogram h;
+    Endpoint e;
+    MoveEntry m;
+    pid_t child;
+    long long start = 0;
+    double seconds;
+    cpu_set_t original;
+    int i, status;
+
+    memset(&e, 0, sizeof(e));
+    memset(&h, 0, sizeof(h));
+    e.sleepUs = sleepUs;
+    e.shared = mmap(NULL, sizeof(Shared), PROT_READ | PROT_WRITE,
+                    MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+    if (e.shared == MAP_FAILED) {
+        exitWithError("mmap error");
+    }
+    t->setup(&e);
+
+    // or the child would print what is still buffered again
+    fflush(stdout);
+    if ((child = fork()) < 0) {
+        exitWithError("fork error");
+    }
+
+    if (child == 0) {
+        e.side = 1;
+        e.peer = getppid();
+        pinTo(cpus[1]);
+        t->open(&e);
+        for (i = 0; i < warmup + rounds; i++) {
+            t->receive(&e, &m);
+            t->send(&e, &m);
+        }
+        t->close(&e);
+        exit(0);
+    }
+
+    e.side = 0;
+    e.peer = child;
+    // the next transport starts from the cpus we had
+    if (sched_getaffinity(0, sizeof(original), &original) < 0) {
+        exitWithError("sched_getaffinity error");
+    }
+    pinTo(cpus[0]);
+    t->open(&e);
+
+    memset(&m, 0, sizeof(m));
+    for (i = 0; i < warmup + rounds; i++) {
+        long long sent;
+
+        if (i == warmup) {
+            start = nowNs();
+        }
+
+        m.moveNumber = i;
+        sent = nowNs();
+        t->send(&e, &m);
+        t->receive(&e, &m);
+        latencyRecord(&h, nowNs() - sent);
+
+        if (m.moveNumber != (uint32_t) i) {
+            fprintf(stderr, "%s: message %d came back as %u\n", t->name, i,
+                    m.moveNumber);
+            exit(-1);
+        }
+
+        // the warmup isn't counted
+        if (i == warmup - 1) {
+            memset(&h, 0, sizeof(h));
+        }
+    }
+    seconds = (nowNs() - start) / 1e9;
+
+    if (waitpid(child, &status, 0) < 0) {
+        exitWithError("waitpid error");
+    }
+    t->close(&e);
+    munmap(e.shared, sizeof(Shared));
+    if (sched_setaffinity(0, sizeof(original), &original) < 0) {
+        exitWithError("sched_setaffinity error");
+    }
+
+    printf("%-8s %10.0f msgs/sec  p50 %8.2f us  p99 %8.2f us  p99.9 %8.2f us  "
+           "max %9.2f us\n", t->name, seconds > 0 ? 2 * rounds / seconds : 0.0,
+           latencyPercentile(&h, 0.5) / 1e3, latencyPercentile(&h, 0.99) / 1e3,
+           latencyPercentile(&h, 0.999) / 1e3, latencyPercentile(&h, 1.0) / 1e3);
+    fflush(stdout);
+}
+
+/*******************************************************************************
+* function name : findTransport
+* input : const char *name
+* output : the transport called name, NULL if there is none
+* explanation : -
+*******************************************************************************/
+const Transport *findTransport(const char *name) {
+    int k;
+
+    for (k = 0; k < TRANSPORTS; k++) {
+        if (!strcmp(name, transports[k].name)) {
+            return &transports[k];
+        }
+    }
+    return NULL;
+}
+
+/*******************************************************************************
+* function name : usage
+* input : const char *name - argv[0]
+* output : -
+* explanation : print the usage and the transports and exit with -1.
+*******************************************************************************/
+void usage(const char *name) {
+    int k;
+
+    fprintf(stderr, "usage: %s [-n rounds] [-w warmup] [-c cpu,cpu] [-s us] "
+            "[transport...]\ntransports:", name);
+    for (k = 0; k < TRANSPORTS; k++) {
+        fprintf(stderr, " %s", transports[k].name);
+    }
+    fprintf(stderr, "\n");
+    exit(-1);
+}
+
+/*******************************************************************************
+* function name : main
+* input : int argc, char **argv
+* output : 0
+* explanation : ipcbench [-n rounds] [-w warmup] [-c cpu,cpu] [-s us]
+*               [transport...] ping pongs a move between two processes over
+*               each transport (all of them by default) and prints the round
+*               trip times.
+*******************************************************************************/
+int main(int argc, char **argv) {
+    int rounds = DEFAULT_ROUNDS, warmup = DEFAULT_WARMUP, sleepUs = DEFAULT_SLEEP;
+    int cpus[2] = {-1, -1};
+    int opt, i;
+
+    while ((opt = getopt(argc, argv, "n:w:c:s:")) != -1) {
+        switch (opt) {
+            case 'n': rounds = atoi(optarg);
+                break;
+            case 'w': warmup = atoi(optarg);
+                break;
+            case 'c':
+                if (sscanf(optarg, "%d,%d", &cpus[0], &cpus[1]) != 2) {
+                    cpus[1] = cpus[0];
+                }
+                break;
+            case 's': sleepUs = atoi(optarg);
+                break;
+            default:
+                usage(argv[0]);
+        }
+    }
+
+    if (rounds < 1) rounds = 1;
+    if (warmup < 0) warmup = 0;
+
+    for (i = optind; i < argc; i++) {
+        if (!findTransport(argv[i])) {
+            fprintf(stderr, "no transport %s\n", argv[i]);
+            usage(argv[0]);
+        }
+    }
+
+    printf("%d round trips of a %zu byte move, cpus %d and %d (-1 is any), "
+           "times are round trips\n", rounds, sizeof(MoveEntry), cpus[0], cpus[1]);
+
+    if (optind == argc) {
+        for (i = 0; i < TRANSPORTS; i++) {
+            runTransport(&transports[i], rounds, warmup, cpus, sleepUs);
+        }
+    }
+    for (i = optind; i < argc; i++) {
+        runTransport(findTransport(argv[i]), rounds, warmup, cpus, sleepUs);
+    }
+
+    return 0;
+}
@@ -0,0 +1,215 @@
+/*
+ * Student name : Or Zipori
+ * Student : 302933833
+ * Course Exercise Group : 03
+ * Exercise Name : ex3
+ */
+#ifndef LATENCY_H
+#define LATENCY_H
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+/*
+ * latency histograms in the style of HdrHistogram - every power of 2 of
+ * nanoseconds is split into LATENCY_SUB buckets, so a value is known to
+ * within 1/16 of itself from 1 ns up to 2^40 ns (about 18 minutes) in a
+ * few kilobytes.
+ */
+#define LATENCY_SUB_BITS 4
+#define LATENCY_SUB (1 << LATENCY_SUB_BITS)
+#define LATENCY_MAX_BITS 40
+#define LATENCY_BUCKETS ((LATENCY_MAX_BITS - LATENCY_SUB_BITS + 1) * LATENCY_SUB)
+
+/*
+ * the stages of a move from one player to the other, and of the end of a
+ * game to the server:
+ * publish - the move is chosen until it is in the ring
+ * deliver - it is in the ring until the opponent sees it
+ * apply   - the opponent sees it until it is played on its board
+ * move    - chosen until played on the opponent's board
+ * reap    - the second player left the game until the server took it
+ */
+typedef enum {
+    LATENCY_PUBLISH = 0, LATENCY_DELIVER, LATENCY_APPLY, LATENCY_MOVE,
+    LATENCY_REAP, LATENCY_STAGES
+} LatencyStage;
+
+/*******************************************************************************
+* function name : latencyStageName
+* input : int stage - a LatencyStage
+* output : the name of stage
+* explanation : -
+*******************************************************************************/
+static inline const char *latencyStageName(int stage) {
+    static const char *names[LATENCY_STAGES] = {
+        "publish", "deliver", "apply", "move", "reap"
+    };
+    return stage >= 0 && stage < LATENCY_STAGES ? names[stage] : "?";
+}
+
+typedef struct {
+    uint64_t count;
+    uint64_t sum;
+    uint64_t buckets[LATENCY_BUCKETS];
+} LatencyHistogram;
+
+/*******************************************************************************
+* function name : latencyIndex
+* input : uint64_t ns
+* output : the bucket of ns
+* explanation : below LATENCY_SUB a bucket per value, above it the top
+*               LATENCY_SUB_BITS bits after the highest one.
+*******************************************************************************/
+static inline int latencyIndex(uint64_t ns) {
+    int e;
+
+    if (ns < LATENCY_SUB) {
+        return (int) ns;
+    }
+    if (ns >> LATENCY_MAX_BITS) {
+        ns = (1ULL << LATENCY_MAX_BITS) - 1;
+    }
+
+    e = 63 - __builtin_clzll(ns);
+    return (e - LATENCY_SUB_BITS + 1) * LATENCY_SUB +
+           (int) ((ns >> (e - LATENCY_SUB_BITS)) & (LATENCY_SUB - 1));
+}
+
+/*******************************************************************************
+* function name : latencyValue
+* input : int index
+* output : the smallest value of bucket index
+* explanation : -
+*******************************************************************************/
+static inline uint64_t latencyValue(int index) {
+    int e = index / LATENCY_SUB + LATENCY_SUB_BITS - 1;
+
+    if (index < LATENCY_SUB) {
+        return index;
+    }
+    return (uint64_t) (LATENCY_SUB + index % LATENCY_SUB) << (e - LATENCY_SUB_BITS);
+}
+
+/*******************************************************************************
+* function name : latencyRecord
+* input : LatencyHistogram *h, uint64_t ns
+* output : -
+* explanation : count one value in a histogram of this thread only.
+*******************************************************************************/
+static inline void latencyRecord(LatencyHistogram *h, uint64_t ns) {
+    h->count++;
+    h->sum += ns;
+    h->buckets[latencyIndex(ns)]++;
+}
+
+/*******************************************************************************
+* function name : latencyAdd
+* input : LatencyHistogram *h, uint64_t ns
+* output : -
+* explanation : count one value in a histogram shared with other threads
+*               or processes.
+*******************************************************************************/
+static inline void latencyAdd(LatencyHistogram *h, uint64_t ns) {
+    __atomic_fetch_add(&h->count, 1, __ATOMIC_RELAXED);
+    __atomic_fetch_add(&h->sum, ns, __ATOMIC_RELAXED);
+    __atomic_fetch_add(&h->buckets[latencyIndex(ns)], 1, __ATOMIC_RELAXED);
+}
+
+/*******************************************************************************
+* function name : latencyMerge
+* input : LatencyHistogram *shared, const LatencyHistogram *local
+* output : -
+* explanation : add a private histogram to a shared one, only the buckets
+*               that have values are touched.
+*******************************************************************************/
+static inline void latencyMerge(LatencyHistogram *shared, const LatencyHistogram *local) {
+    int i;
+
+    if (!local->count) {
+        return;
+    }
+
+    __atomic_fetch_add(&shared->count, local->count, __ATOMIC_RELAXED);
+    __atomic_fetch_add(&shared->sum, local->sum, __ATOMIC_RELAXED);
+    for (i = 0; i < LATENCY_BUCKETS; i++) {
+        if (local->buckets[i]) {
+            __atomic_fetch_add(&shared->buckets[i], local->buckets[i], __ATOMIC_RELAXED);
+        }
+    }
+}
+
+/*******************************************************************************
+* function name : latencySnapshot
+* input : LatencyHistogram *out, const LatencyHistogram *shared
+* output : -
+* explanation : copy a shared histogram that may be changing, each counter
+*               is read whole.
+*******************************************************************************/
+static inline void latencySnapshot(LatencyHistogram *out, const LatencyHistogram *shared) {
+    int i;
+
+    out->count = __atomic_load_n(&shared->count, __ATOMIC_RELAXED);
+    out->sum = __atomic_load_n(&shared->sum, __ATOMIC_RELAXED);
+    for (i = 0; i < LATENCY_BUCKETS; i++) {
+        out->buckets[i] = __atomic_load_n(&shared->buckets[i], __ATOMIC_RELAXED);
+    }
+}
+
+/*******************************************************************************
+* function name : latencyPercentile
+* input : const LatencyHistogram *h, double q - between 0 and 1
+* output : the value q of the values are at most, in nanoseconds
+* explanation : the top of the bucket it falls in, like HdrHistogram's
+*               highest equivalent value.
+*******************************************************************************/
+static inline uint64_t latencyPercentile(const LatencyHistogram *h, double q) {
+    uint64_t total = 0, rank;
+    int i;
+
+    for (i = 0; i < LATENCY_BUCKETS; i++) {
+        total += h->buckets[i];
+    }
+    if (!total) {
+        return 0;
+    }
+
+    rank = (uint64_t) (q * total + 0.5);
+    if (rank < 1) rank = 1;
+    if (rank > total) rank = total;
+
+    for (i = 0; i < LATENCY_BUCKETS; i++) {
+        if (h->buckets[i] >= rank) {
+            break;
+        }
+        rank -= h->buckets[i];
+    }
+
+    return i + 1 < LATENCY_BUCKETS ? latencyValue(i + 1) - 1 : latencyValue(i);
+}
+
+/*******************************************************************************
+* function name : latencyPrint
+* input : FILE *out, const char *name, const LatencyHistogram *shared
+* output : -
+* explanation : one line of a histogram, the times in microseconds.
+*******************************************************************************/
+static inline void latencyPrint(FILE *out, const char *name,
+                                const LatencyHistogram *shared) {
+    LatencyHistogram h;
+
+    latencySnapshot(&h, shared);
+    if (!h.count) {
+        fprintf(out, "  %-8s no samples\n", name);
+        return;
+    }
+
+    fprintf(out, "  %-8s %8llu samples, mean %9.1f us, p50 %9.1f, p99 %9.1f, "
+            "p99.9 %9.1f, max %9.1f\n", name, (unsigned long long) h.count,
+            h.sum / 1e3 / h.count, latencyPercentile(&h, 0.5) / 1e3,
+            latencyPercentile(&h, 0.99) / 1e3, latencyPercentile(&h, 0.999) / 1e3,
+            latencyPercentile(&h, 1.0) / 1e3);
+}
+
+#endif
@@ -0,0 +1,371 @@
+/*
+ * Student name : Or Zipori
+ * Student : 302933833
+ * Course Exercise Group : 03
+ * Exercise Name : ex3
+ */
+#ifndef OTHELLO_H
+#define OTHELLO_H
+
+#include <stdint.h>
+
+#define BOARD_SIZE 8
+#define BLACK 2
+#define WHITE 1
+#define FREE 0
+#define SQUARES (BOARD_SIZE * BOARD_SIZE)
+#define DIRECTIONS 8
+
+// square index of [x,y] - rows are y, columns are x (same as board[y][x])
+#define SQUARE(x, y) ((y) * BOARD_SIZE + (x))
+#define SQUARE_BIT(sq) (1ULL << (sq))
+#define OPPONENT(player) (WHITE + BLACK - (player))
+
+// move number recorded for a pass
+#define PASS_MOVE SQUARES
+// 60 moves and at most as many passes
+#define MAX_PLIES 128
+
+typedef enum {INVALID_SQUARE = 0,NO_SUCH_SQUARE, VALID_MOVE} MoveMode;
+typedef enum {BLACK_WIN = 1, WHITE_WIN, DRAW, NO_END} EndMode;
+typedef enum {FALSE = 0, TRUE} Boolean;
+typedef struct {
+    int x;
+    int y;
+} Point;
+
+// one bit per square, bit number is SQUARE(x, y)
+typedef uint64_t Bitboard;
+
+// every column but the first / every column but the last
+#define NOT_FIRST_COLUMN 0xfefefefefefefefeULL
+#define NOT_LAST_COLUMN 0x7f7f7f7f7f7f7f7fULL
+
+// right, left, down, up, down right, down left, upper right, upper left
+static const int dirShift[DIRECTIONS] = {1, -1, 8, -8, 9, 7, -7, -9};
+
+// squares that may be reached after a shift without wrapping a row
+static const Bitboard dirMask[DIRECTIONS] = {
+    NOT_FIRST_COLUMN, NOT_LAST_COLUMN, ~0ULL, ~0ULL,
+    NOT_FIRST_COLUMN, NOT_LAST_COLUMN, NOT_FIRST_COLUMN, NOT_LAST_COLUMN
+};
+
+/*******************************************************************************
+* function name : shiftBoard
+* input : Bitboard b, int dir
+* output : b moved one square in the direction dir
+* explanation : discs that would leave the board are dropped.
+*******************************************************************************/
+static inline Bitboard shiftBoard(Bitboard b, int dir) {
+    int s = dirShift[dir];
+    return ((s > 0) ? (b << s) : (b >> -s)) & dirMask[dir];
+}
+
+/*******************************************************************************
+* function name : countDiscs
+* input : Bitboard b
+* output : number of discs in b
+* explanation : population count.
+*******************************************************************************/
+static inline int countDiscs(Bitboard b) {
+    return __builtin_popcountll(b);
+}
+
+/*******************************************************************************
+* function name : generateMoves
+* input : Bitboard own, Bitboard opp
+* output : mask of all the legal moves of own
+* explanation : for each direction spread own discs over a line of opponent
+*               discs (at most 6 long) and keep the free square behind it.
+*******************************************************************************/
+static inline Bitboard generateMoves(Bitboard own, Bitboard opp) {
+    Bitboard empty = ~(own | opp);
+    Bitboard moves = 0;
+    int d;
+
+    for (d = 0; d < DIRECTIONS; d++) {
+        Bitboard t = shiftBoard(own, d) & opp;
+        t |= shiftBoard(t, d) & opp;
+        t |= shiftBoard(t, d) & opp;
+        t |= shiftBoard(t, d) & opp;
+        t |= shiftBoard(t, d) & opp;
+        t |= shiftBoard(t, d) & opp;
+        moves |= shiftBoard(t, d) & empty;
+    }
+
+    return moves;
+}
+
+/*******************************************************************************
+* function name : computeFlips
+* input : Bitboard own, Bitboard opp, int sq
+* output : mask of the opponent discs flipped by playing sq, 0 if illegal
+* explanation : walk each direction over opponent discs, keep the line only if
+*               it is closed by one of our discs.
+*******************************************************************************/
+static inline Bitboard computeFlips(Bitboard own, Bitboard opp, int sq) {
+    Bitboard flips = 0;
+    int d;
+
+    for (d = 0; d < DIRECTIONS; d++) {
+        Bitboard line = 0;
+        Bitboard cur = shiftBoard(SQUARE_BIT(sq), d);
+
+        while (cur & opp) {
+            line |= cur;
+            cur = shiftBoard(cur, d);
+        }
+
+        if (cur & own) {
+            flips |= line;
+        }
+    }
+
+    return flips;
+}
+
+/*******************************************************************************
+* function name : parseSquare
+* input : const char *s
+* output : the square written as a column letter and a row digit ("c4"),
+*          -1 if s doesn't start with one
+* explanation : column a-h is x 0-7, row 1-8 is y 0-7.
+*******************************************************************************/
+static inline int parseSquare(const char *s) {
+    int x = s[0] - 'a', y = s[1] - '1';
+
+    if (s[0] >= 'A' && s[0] <= 'H') {
+        x = s[0] - 'A';
+    }
+
+    if (x < 0 || x >= BOARD_SIZE || y < 0 || y >= BOARD_SIZE) {
+        return -1;
+    }
+
+    return SQUARE(x, y);
+}
+
+/*
+ * zobrist keys - one per coin colour and square, plus one for the side to
+ * move. they come from a fixed seed so every process (and every file written
+ * with them) agrees on the hash of a position.
+ */
+#define ZOBRIST_SEED 0x0e3b5a1d2c4f6789ULL
+
+static uint64_t zobrist[3][SQUARES];
+static uint64_t zobristSide;
+static Boolean zobristReady = FALSE;
+
+/*******************************************************************************
+* function name : splitMix64
+* input : uint64_t *state
+* output : next pseudo random number
+* explanation : splitmix64 generator.
+*******************************************************************************/
+static inline uint64_t splitMix64(uint64_t *state) {
+    uint64_t z = (*state += 0x9e3779b97f4a7c15ULL);
+    z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+    return z ^ (z >> 31);
+}
+
+/*******************************************************************************
+* function name : initZobrist
+* input : -
+* output : -
+* explanation : fill the zobrist keys, only once. free squares hash to 0.
+*******************************************************************************/
+static inline void initZobrist() {
+    uint64_t state = ZOBRIST_SEED;
+    int sq;
+
+    if (zobristReady) {
+        return;
+    }
+
+    for (sq = 0; sq < SQUARES; sq++) {
+        zobrist[FREE][sq] = 0;
+        zobrist[WHITE][sq] = splitMix64(&state);
+        zobrist[BLACK][sq] = splitMix64(&state);
+    }
+    zobristSide = splitMix64(&state);
+    zobristReady = TRUE;
+}
+
+/*
+ * a position and the moves that led to it. all the state of a game lives
+ * here, so any number of positions can be searched side by side, and moves
+ * are taken back from the undo stack without any allocation.
+ */
+typedef struct {
+    Bitboard flips;
+    Bitboard legalMoves;
+    uint64_t hash;
+    int move;
+} Undo;
+
+typedef struct {
+    Bitboard discs[3];
+    int discCount[3];
+    int sideToMove;
+    Bitboard legalMoves;
+    // zobrist hash of the discs and the side to move
+    uint64_t hash;
+    int ply;
+    Undo undo[MAX_PLIES];
+} Position;
+
+/*******************************************************************************
+* function name : initPosition
+* input : Position *pos
+* output : -
+* explanation : set the opening position, black to move.
+*******************************************************************************/
+static inline void initPosition(Position *pos) {
+    pos->discs[FREE] = 0;
+    pos->discs[BLACK] = SQUARE_BIT(SQUARE(3, 3)) | SQUARE_BIT(SQUARE(4, 4));
+    pos->discs[WHITE] = SQUARE_BIT(SQUARE(3, 4)) | SQUARE_BIT(SQUARE(4, 3));
+    pos->discCount[FREE] = 0;
+    pos->discCount[BLACK] = 2;
+    pos->discCount[WHITE] = 2;
+    pos->sideToMove = BLACK;
+    pos->legalMoves = generateMoves(pos->discs[BLACK], pos->discs[WHITE]);
+    pos->ply = 0;
+
+    initZobrist();
+    pos->hash = zobrist[BLACK][SQUARE(3, 3)] ^ zobrist[BLACK][SQUARE(4, 4)] ^
+                zobrist[WHITE][SQUARE(3, 4)] ^ zobrist[WHITE][SQUARE(4, 3)];
+}
+
+/*******************************************************************************
+* function name : squareContent
+* input : const Position *pos, int sq
+* output : WHITE, BLACK or FREE
+* explanation : the coin on a square.
+*******************************************************************************/
+static inline int squareContent(const Position *pos, int sq) {
+    if (pos->discs[WHITE] & SQUARE_BIT(sq)) return WHITE;
+    if (pos->discs[BLACK] & SQUARE_BIT(sq)) return BLACK;
+    return FREE;
+}
+
+/*******************************************************************************
+* function name : makeMove
+* input : Position *pos, int sq
+* output : the flipped discs, 0 if the move is illegal (nothing is changed)
+* explanation : play sq for the side to move and give the turn away.
+*******************************************************************************/
+static inline Bitboard makeMove(Position *pos, int sq) {
+    int player = pos->sideToMove;
+    int opp = OPPONENT(player);
+    Bitboard flips = computeFlips(pos->discs[player], pos->discs[opp], sq);
+    Bitboard f;
+    Undo *u;
+    int flipped;
+
+    if (!flips || ((pos->discs[WHITE] | pos->discs[BLACK]) & SQUARE_BIT(sq))) {
+        return 0;
+    }
+
+    u = &pos->undo[pos->ply++];
+    u->flips = flips;
+    u->legalMoves = pos->legalMoves;
+    u->hash = pos->hash;
+    u->move = sq;
+
+    // each flipped coin changes colour in the hash
+    pos->hash ^= zobrist[player][sq] ^ zobristSide;
+    for (f = flips; f; f &= f - 1) {
+        int fsq = __builtin_ctzll(f);
+        pos->hash ^= zobrist[WHITE][fsq] ^ zobrist[BLACK][fsq];
+    }
+
+    flipped = countDiscs(flips);
+    pos->discs[player] |= flips | SQUARE_BIT(sq);
+    pos->discs[opp] &= ~flips;
+    pos->discCount[player] += flipped + 1;
+    pos->discCount[opp] -= flipped;
+    pos->sideToMove = opp;
+    pos->legalMoves = generateMoves(pos->discs[opp], pos->discs[player]);
+
+    return flips;
+}
+
+/*******************************************************************************
+* function name : makePass
+* input : Position *pos
+* output : -
+* explanation : give the turn away without playing.
+*******************************************************************************/
+static inline void makePass(Position *pos) {
+    int opp = OPPONENT(pos->sideToMove);
+    Undo *u = &pos->undo[pos->ply++];
+
+    u->flips = 0;
+    u->legalMoves = pos->legalMoves;
+    u->hash = pos->hash;
+    u->move = PASS_MOVE;
+
+    pos->hash ^= zobristSide;
+
+    pos->legalMoves = generateMoves(pos->discs[opp], pos->discs[pos->sideToMove]);
+    pos->sideToMove = opp;
+}
+
+/*******************************************************************************
+* function name : unmakeMove
+* input : Position *pos
+* output : -
+* explanation : take back the last move or pass.
+*******************************************************************************/
+static inline void unmakeMove(Position *pos) {
+    Undo *u = &pos->undo[--pos->ply];
+    int player = OPPONENT(pos->sideToMove);
+
+    if (u->move != PASS_MOVE) {
+        int flipped = countDiscs(u->flips);
+        pos->discs[player] &= ~(u->flips | SQUARE_BIT(u->move));
+        pos->discs[pos->sideToMove] |= u->flips;
+        pos->discCount[player] -= flipped + 1;
+        pos->discCount[pos->sideToMove] += flipped;
+    }
+
+    pos->sideToMove = player;
+    pos->legalMoves = u->legalMoves;
+    pos->hash = u->hash;
+}
+
+/*******************************************************************************
+* function name : mustPass
+* input : const Position *pos
+* output : TRUE if the side to move has no move but the opponent has
+* explanation : only looks at the opponent when the side to move is stuck.
+*******************************************************************************/
+static inline Boolean mustPass(const Position *pos) {
+    int player = pos->sideToMove;
+    if (pos->legalMoves) {
+        return FALSE;
+    }
+    return generateMoves(pos->discs[OPPONENT(player)], pos->discs[player]) ?
+           TRUE : FALSE;
+}
+
+/*******************************************************************************
+* function name : positionResult
+* input : const Position *pos
+* output : WHITE_WIN, BLACK_WIN or DRAW
+* explanation : winner by disc count, meaningful once nobody can move.
+*******************************************************************************/
+static inline EndMode positionResult(const Position *pos) {
+    if (pos->discCount[WHITE] > pos->discCount[BLACK]) {
+        return WHITE_WIN;
+    }
+
+    if (pos->discCount[WHITE] < pos->discCount[BLACK]) {
+        return BLACK_WIN;
+    }
+
+    return DRAW;
+}
+
+#endif
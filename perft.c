@@ -0,0 +1,228 @@
+/*
+ * Student name : Or Zipori
+ * Student : 302933833
+ * Course Exercise Group : 03
+ * Exercise Name : ex3
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include "othello.h"
+#include "timer.h"
+
+#define DEFAULT_DEPTH 9
+#define KNOWN_DEPTHS 14
+
+// leaf counts from the opening position, a pass counts as a move
+static const unsigned long long knownPerft[KNOWN_DEPTHS + 1] = {
+    1ULL, 4ULL, 12ULL, 56ULL, 244ULL, 1396ULL, 8200ULL, 55092ULL, 390216ULL,
+    3005288ULL, 24571284ULL, 212258800ULL, 1939886636ULL, 18429641748ULL,
+    184042084512ULL
+};
+
+/*******************************************************************************
+* function name : perft
+* input : Position *pos, int depth
+* output : number of leaves depth plies below pos
+* explanation : a finished game is a leaf whatever the depth left.
+*******************************************************************************/
+unsigned long long perft(Position *pos, int depth) {
+    Bitboard moves = pos->legalMoves;
+    unsigned long long nodes = 0;
+
+    if (!moves) {
+        if (!mustPass(pos)) {
+            return 1;
+        }
+        if (depth == 1) {
+            return 1;
+        }
+
+        makePass(pos);
+        nodes = perft(pos, depth - 1);
+        unmakeMove(pos);
+        return nodes;
+    }
+
+    // the leaves are the moves themselves
+    if (depth == 1) {
+        return countDiscs(moves);
+    }
+
+    for (; moves; moves &= moves - 1) {
+        makeMove(pos, __builtin_ctzll(moves));
+        nodes += perft(pos, depth - 1);
+        unmakeMove(pos);
+    }
+
+    return nodes;
+}
+
+/*
+ * the scalar move rules the player used before the bitboards, kept to
+ * compare against. a move walks each of the eight directions square by
+ * square over an int board[y][x].
+ */
+static const int legacyDx[DIRECTIONS] = {0, 0, 1, -1, 1, -1, 1, -1};
+static const int legacyDy[DIRECTIONS] = {-1, 1, 0, 0, -1, -1, 1, 1};
+
+/*******************************************************************************
+* function name : legacyCheckMove
+* input : int board[][BOARD_SIZE], int x, int y, int player,
+*         Boolean writeToBoard
+* output : VALID_MOVE if the move is legal, else INVALID_SQUARE
+* explanation : check every direction, flip the closed lines if writeToBoard.
+*******************************************************************************/
+MoveMode legacyCheckMove(int board[][BOARD_SIZE], int x, int y, int player,
+                         Boolean writeToBoard) {
+    int opp = OPPONENT(player);
+    MoveMode m = INVALID_SQUARE;
+    int d;
+
+    if (board[y][x] != FREE) {
+        return INVALID_SQUARE;
+    }
+
+    for (d = 0; d < DIRECTIONS; d++) {
+        int i = x + legacyDx[d], j = y + legacyDy[d], k = 0;
+
+        // walk over the opponent's coins
+        while (i >= 0 && i < BOARD_SIZE && j >= 0 && j < BOARD_SIZE &&
+               board[j][i] == opp) {
+            i += legacyDx[d];
+            j += legacyDy[d];
+            k++;
+        }
+
+        // only if closed by the player's coin and not next to it
+        if (k == 0 || i < 0 || i >= BOARD_SIZE || j < 0 || j >= BOARD_SIZE ||
+            board[j][i] != player) {
+            continue;
+        }
+
+        m = VALID_MOVE;
+        if (!writeToBoard) {
+            return m;
+        }
+
+        while (k-- > 0) {
+            i -= legacyDx[d];
+            j -= legacyDy[d];
+            board[j][i] = player;
+        }
+    }
+
+    if (m == VALID_MOVE) {
+        board[y][x] = player;
+    }
+
+    return m;
+}
+
+/*******************************************************************************
+* function name : legacyPerft
+* input : int board[][BOARD_SIZE], int player, int depth, Boolean passed
+* output : number of leaves depth plies below the board
+* explanation : same count as perft, copying the board for every move.
+*******************************************************************************/
+unsigned long long legacyPerft(int board[][BOARD_SIZE], int player, int depth,
+                               Boolean passed) {
+    unsigned long long nodes = 0;
+    Boolean hasMoves = FALSE;
+    int x, y;
+
+    for (y = 0; y < BOARD_SIZE; y++) {
+        for (x = 0; x < BOARD_SIZE; x++) {
+            int next[BOARD_SIZE][BOARD_SIZE];
+
+            if (legacyCheckMove(board, x, y, player, FALSE) != VALID_MOVE) {
+                continue;
+            }
+
+            hasMoves = TRUE;
+            if (depth == 1) {
+                nodes++;
+                continue;
+            }
+
+            memcpy(next, board, sizeof(next));
+            legacyCheckMove(next, x, y, player, TRUE);
+            nodes += legacyPerft(next, OPPONENT(player), depth - 1, FALSE);
+        }
+    }
+
+    if (hasMoves) {
+        return nodes;
+    }
+
+    // neither player can move - the game is over
+    if (passed || depth == 1) {
+        return 1;
+    }
+
+    // pass - if the opponent can't move either he returns 1 as a finished game
+    return legacyPerft(board, OPPONENT(player), depth - 1, TRUE);
+}
+
+/*******************************************************************************
+* function name : main
+* input : int argc, char **argv
+* output : 0 if all the known counts matched, else 1
+* explanation : count perft 1..depth, print the counts and nodes/sec.
+*******************************************************************************/
+int main(int argc, char **argv) {
+    int maxDepth = DEFAULT_DEPTH;
+    Boolean legacy = FALSE, failed = FALSE;
+    int opt, depth;
+
+    while ((opt = getopt(argc, argv, "d:l")) != -1) {
+        switch (opt) {
+            case 'd': maxDepth = atoi(optarg);
+                break;
+            case 'l': legacy = TRUE;
+                break;
+            default:
+                fprintf(stderr, "usage: %s [-d depth] [-l]\n", argv[0]);
+                exit(-1);
+        }
+    }
+
+    printf("%s move generator\n", legacy ? "legacy scalar" : "bitboard");
+    printf("%5s %16s %10s %14s\n", "depth", "nodes", "seconds", "nodes/sec");
+
+    for (depth = 1; depth <= maxDepth; depth++) {
+        unsigned long long nodes;
+        long long start = nowNs();
+        double seconds;
+        const char *status = "";
+
+        if (legacy) {
+            int board[BOARD_SIZE][BOARD_SIZE] = {{FREE}};
+            board[3][3] = BLACK;
+            board[4][4] = BLACK;
+            board[4][3] = WHITE;
+            board[3][4] = WHITE;
+            nodes = legacyPerft(board, BLACK, depth, FALSE);
+        } else {
+            Position pos;
+            initPosition(&pos);
+            nodes = perft(&pos, depth);
+        }
+
+        seconds = (nowNs() - start) / 1e9;
+        if (depth <= KNOWN_DEPTHS) {
+            if (nodes == knownPerft[depth]) {
+                status = "ok";
+            } else {
+                status = "MISMATCH";
+                failed = TRUE;
+            }
+        }
+
+        printf("%5d %16llu %10.3f %14.0f %s\n", depth, nodes, seconds,
+               seconds > 0 ? nodes / seconds : 0.0, status);
+    }
+
+    return failed ? 1 : 0;
+}
@@ -0,0 +1,404 @@
+/*
+ * Student name : Or Zipori
+ * Student : 302933833
+ * Course Exercise Group : 03
+ * Exercise Name : ex3
+ */
+#ifndef SEARCH_H
+#define SEARCH_H
+
+#include <pthread.h>
+#include <stdatomic.h>
+#include "othello.h"
+#include "timer.h"
+#include "tt.h"
+#include "eval.h"
+
+#define INF_SCORE 32000
+// scores at or beyond WIN_SCORE are finished games (plus the disc difference)
+#define WIN_SCORE 20000
+#define MAX_DEPTH 64
+#define NO_MOVE -1
+// how often the clock is read, must be a power of 2
+#define TIME_CHECK_NODES 1024
+#define MAX_THREADS 256
+
+#define CORNERS 0x8100000000000081ULL
+
+/*
+ * state of one search thread. the position is a private copy, the search
+ * plays and takes back moves on it. tt may be NULL. sharedStop is raised by
+ * the main thread to end the search of all the threads.
+ */
+typedef struct {
+    Position pos;
+    TransTable *tt;
+    atomic_int *sharedStop;
+    int id;
+    uint64_t nodes;
+    uint64_t ttProbes;
+    uint64_t ttHits;
+    long long deadline;
+    Boolean stop;
+    int maxDepth;
+    int bestMove;
+    int bestScore;
+    int depth;
+} SearchContext;
+
+/*
+ * lazy SMP - every thread runs its own iterative deepening on the same root
+ * and they share work only through the transposition table. ctx[0] runs on
+ * the calling thread.
+ */
+typedef struct {
+    int threads;
+    TransTable *tt;
+    atomic_int stop;
+    SearchContext *ctx;
+    pthread_t *tid;
+    // deepest iteration, MAX_DEPTH unless the search has a fixed depth
+    int maxDepth;
+    // wall time of the last search, in nanoseconds
+    long long elapsed;
+} SearchPool;
+
+/*******************************************************************************
+* function name : finalScore
+* input : const Position *pos
+* output : score of a finished game for the side to move
+* explanation : any win beats any evaluation, bigger wins are better.
+*******************************************************************************/
+static inline int finalScore(const Position *pos) {
+    int player = pos->sideToMove;
+    int diff = pos->discCount[player] - pos->discCount[OPPONENT(player)];
+
+    if (diff > 0) return WIN_SCORE + diff;
+    if (diff < 0) return -WIN_SCORE + diff;
+    return 0;
+}
+
+/*******************************************************************************
+* function name : evaluate
+* input : const Position *pos
+* output : static score for the side to move
+* explanation : the pattern evaluation, see eval.h.
+*******************************************************************************/
+static inline int evaluate(const Position *pos) {
+    return patternEvaluate(pos);
+}
+
+/*******************************************************************************
+* function name : orderMoves
+* input : Bitboard moves, int first, int list[]
+* output : number of moves in list
+* explanation : first (if legal), then corners, then the rest.
+*******************************************************************************/
+static inline int orderMoves(Bitboard moves, int first, int list[]) {
+    Bitboard corners;
+    int n = 0;
+
+    if (first >= 0 && first < SQUARES && (moves & SQUARE_BIT(first))) {
+        list[n++] = first;
+        moves &= ~SQUARE_BIT(first);
+    }
+
+    for (corners = moves & CORNERS; corners; corners &= corners - 1) {
+        list[n++] = __builtin_ctzll(corners);
+    }
+
+    for (moves &= ~CORNERS; moves; moves &= moves - 1) {
+        list[n++] = __builtin_ctzll(moves);
+    }
+
+    return n;
+}
+
+/*******************************************************************************
+* function name : negamax
+* input : SearchContext *ctx, int depth, int alpha, int beta
+* output : score of ctx->pos for the side to move
+* explanation : alpha-beta search, stops early once the deadline passes.
+*               results are kept in the transposition table.
+*******************************************************************************/
+static int negamax(SearchContext *ctx, int depth, int alpha, int beta) {
+    Position *pos = &ctx->pos;
+    int alphaOrig = alpha;
+    int best = -INF_SCORE, bestMove = NO_MOVE, ttMove = NO_MOVE;
+    int list[SQUARES];
+    int n, i;
+
+    if ((++ctx->nodes & (TIME_CHECK_NODES - 1)) == 0 &&
+        (nowNs() > ctx->deadline ||
+         atomic_load_explicit(ctx->sharedStop, memory_order_relaxed))) {
+        ctx->stop = TRUE;
+    }
+
+    if (ctx->stop) {
+        return 0;
+    }
+
+    if (!pos->legalMoves) {
+        int score;
+        if (!mustPass(pos)) {
+            return finalScore(pos);
+        }
+
+        makePass(pos);
+        score = -negamax(ctx, depth, -beta, -alpha);
+        unmakeMove(pos);
+        return score;
+    }
+
+    if (depth == 0) {
+        return evaluate(pos);
+    }
+
+    if (ctx->tt) {
+        TTData e;
+        ctx->ttProbes++;
+        if (ttProbe(ctx->tt, pos->hash, &e)) {
+            ctx->ttHits++;
+            ttMove = (e.move == TT_NO_MOVE) ? NO_MOVE : e.move;
+            if (e.depth >= depth) {
+                if (e.bound == TT_EXACT) return e.score;
+                if (e.bound == TT_LOWER && e.score > alpha) alpha = e.score;
+                if (e.bound == TT_UPPER && e.score < beta) beta = e.score;
+                if (alpha >= beta) return e.score;
+            }
+        }
+    }
+
+    n = orderMoves(pos->legalMoves, ttMove, list);
+    for (i = 0; i < n; i++) {
+        int score;
+
+        makeMove(pos, list[i]);
+        score = -negamax(ctx, depth - 1, -beta, -alpha);
+        unmakeMove(pos);
+
+        if (score > best) {
+            best = score;
+            bestMove = list[i];
+            if (score > alpha) {
+                alpha = score;
+                if (alpha >= beta) {
+                    break;
+                }
+            }
+        }
+    }
+
+    // a stopped search returns garbage, don't keep it
+    if (ctx->tt && !ctx->stop) {
+        int bound = (best <= alphaOrig) ? TT_UPPER :
+                    (best >= beta) ? TT_LOWER : TT_EXACT;
+        ttStore(ctx->tt, pos->hash, depth, bound, best, bestMove);
+    }
+
+    return best;
+}
+
+/*******************************************************************************
+* function name : searchRoot
+* input : SearchContext *ctx, int depth, int firstMove
+* output : best move found, NO_MOVE if the search was stopped
+* explanation : one iteration of the iterative deepening. firstMove (the best
+*               move of the previous iteration) is searched first. helper
+*               threads rotate the other root moves so they don't all walk
+*               the tree in the same order.
+*******************************************************************************/
+static int searchRoot(SearchContext *ctx, int depth, int firstMove) {
+    Position *pos = &ctx->pos;
+    int alpha = -INF_SCORE, bestMove = NO_MOVE;
+    int list[SQUARES];
+    int n = orderMoves(pos->legalMoves, firstMove, list);
+    int skip = (firstMove != NO_MOVE && list[0] == firstMove) ? 1 : 0;
+    int i;
+
+    for (i = 0; i < n; i++) {
+        int sq, score;
+
+        if (i < skip || n - skip <= 1) {
+            sq = list[i];
+        } else {
+            sq = list[skip + (i - skip + ctx->id) % (n - skip)];
+        }
+
+        makeMove(pos, sq);
+        score = -negamax(ctx, depth - 1, -INF_SCORE, -alpha);
+        unmakeMove(pos);
+
+        if (ctx->stop) {
+            return NO_MOVE;
+        }
+
+        if (score > alpha) {
+            alpha = score;
+            bestMove = sq;
+        }
+    }
+
+    ctx->bestScore = alpha;
+    return bestMove;
+}
+
+/*******************************************************************************
+* function name : iterativeDeepening
+* input : SearchContext *ctx, long long start
+* output : -
+* explanation : search one ply deeper each time until stopped, the time is
+*               half used, ctx->maxDepth is done or the whole game tree has
+*               been searched. odd helper threads start one ply deeper than
+*               the others.
+*******************************************************************************/
+static void iterativeDeepening(SearchContext *ctx, long long start) {
+    const Position *pos = &ctx->pos;
+    int empties = SQUARES - pos->discCount[WHITE] - pos->discCount[BLACK];
+    int depth = 1 + (ctx->id & 1);
+
+    // any legal move until the first iteration is done
+    ctx->bestMove = __builtin_ctzll(pos->legalMoves);
+
+    for (; depth <= ctx->maxDepth; depth++) {
+        int move = searchRoot(ctx, depth, ctx->bestMove);
+        if (move == NO_MOVE) {
+            break;
+        }
+
+        ctx->bestMove = move;
+        ctx->depth = depth;
+
+        if (depth >= empties) {
+            break;
+        }
+
+        // only the main thread decides that a deeper iteration won't fit
+        if (ctx->id == 0 && nowNs() - start > (ctx->deadline - start) / 2) {
+            break;
+        }
+    }
+}
+
+/*******************************************************************************
+* function name : helperThread
+* input : void *arg - the thread's SearchContext
+* output : NULL
+* explanation : body of the helper threads.
+*******************************************************************************/
+static void *helperThread(void *arg) {
+    SearchContext *ctx = (SearchContext *) arg;
+    iterativeDeepening(ctx, nowNs());
+    return NULL;
+}
+
+/*******************************************************************************
+* function name : poolInit
+* input : SearchPool *pool, int threads, TransTable *tt
+* output : 0 on success, -1 on failure
+* explanation : allocate the contexts of threads search threads sharing tt,
+*               and the default evaluation weights if none were loaded.
+*******************************************************************************/
+static int poolInit(SearchPool *pool, int threads, TransTable *tt) {
+    if (threads < 1) threads = 1;
+    if (threads > MAX_THREADS) threads = MAX_THREADS;
+
+    // no weights file was loaded
+    if (!evalWeights.ready && evalDefault() < 0) {
+        return -1;
+    }
+
+    pool->threads = threads;
+    pool->tt = tt;
+    pool->maxDepth = MAX_DEPTH;
+    pool->elapsed = 0;
+    atomic_init(&pool->stop, 0);
+    pool->ctx = calloc(threads, sizeof(SearchContext));
+    pool->tid = calloc(threads, sizeof(pthread_t));
+    if (!pool->ctx || !pool->tid) {
+        free(pool->ctx);
+        free(pool->tid);
+        return -1;
+    }
+
+    return 0;
+}
+
+/*******************************************************************************
+* function name : poolFree
+* input : SearchPool *pool
+* output : -
+* explanation : -
+*******************************************************************************/
+static void poolFree(SearchPool *pool) {
+    free(pool->ctx);
+    free(pool->tid);
+    pool->ctx = NULL;
+    pool->tid = NULL;
+}
+
+/*******************************************************************************
+* function name : chooseMove
+* input : SearchPool *pool, const Position *pos, int timeMs
+* output : the move to play, NO_MOVE if the side to move has no move
+* explanation : run all the threads of pool on pos for at most timeMs. the
+*               move of the thread that completed the deepest iteration is
+*               played. the per thread statistics stay in pool->ctx.
+*******************************************************************************/
+static int chooseMove(SearchPool *pool, const Position *pos, int timeMs) {
+    long long start = nowNs();
+    SearchContext *best;
+    int i, started;
+
+    if (pool->tt) {
+        ttNewSearch(pool->tt);
+    }
+    atomic_store(&pool->stop, 0);
+
+    for (i = 0; i < pool->threads; i++) {
+        SearchContext *ctx = &pool->ctx[i];
+        ctx->pos = *pos;
+        ctx->tt = pool->tt;
+        ctx->sharedStop = &pool->stop;
+        ctx->id = i;
+        ctx->nodes = ctx->ttProbes = ctx->ttHits = 0;
+        ctx->stop = FALSE;
+        ctx->deadline = start + (long long) timeMs * 1000000LL;
+        ctx->maxDepth = pool->maxDepth;
+        ctx->bestMove = NO_MOVE;
+        ctx->bestScore = 0;
+        ctx->depth = 0;
+    }
+
+    if (!pos->legalMoves) {
+        pool->elapsed = 0;
+        return NO_MOVE;
+    }
+
+    // a helper that can't be started just doesn't help
+    for (started = 1; started < pool->threads; started++) {
+        if (pthread_create(&pool->tid[started], NULL, helperThread,
+                           &pool->ctx[started]) != 0) {
+            break;
+        }
+    }
+
+    iterativeDeepening(&pool->ctx[0], start);
+
+    atomic_store(&pool->stop, 1);
+    for (i = 1; i < started; i++) {
+        pthread_join(pool->tid[i], NULL);
+    }
+    pool->elapsed = nowNs() - start;
+
+    best = &pool->ctx[0];
+    for (i = 1; i < started; i++) {
+        if (pool->ctx[i].depth > best->depth && pool->ctx[i].bestMove != NO_MOVE) {
+            best = &pool->ctx[i];
+        }
+    }
+
+    return best->bestMove;
+}
+
+#endif
@@ -0,0 +1,36 @@
+/*
+ * Student name : Or Zipori
+ * Student : 302933833
+ * Course Exercise Group : 03
+ * Exercise Name : ex3
+ */
+#ifndef TIMER_H
+#define TIMER_H
+
+#include <time.h>
+
+/*******************************************************************************
+* function name : nowNs
+* input : -
+* output : monotonic time in nanoseconds
+* explanation : -
+*******************************************************************************/
+static inline long long nowNs() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (long long) ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+/*******************************************************************************
+* function name : wallMs
+* input : -
+* output : wall clock time in milliseconds since the epoch
+* explanation : for time stamps that are kept, nowNs is for measuring.
+*******************************************************************************/
+static inline unsigned long long wallMs() {
+    struct timespec ts;
+    clock_gettime(CLOCK_REALTIME, &ts);
+    return (unsigned long long) ts.tv_sec * 1000ULL + ts.tv_nsec / 1000000;
+}
+
+#endif
@@ -0,0 +1,638 @@
+/*
+ * Student name : Or Zipori
+ * Student : 302933833
+ * Course Exercise Group : 03
+ * Exercise Name : ex3
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include <math.h>
+#include <limits.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include "othello.h"
+#include "tt.h"
+#include "search.h"
+#include "endgame.h"
+#include "timer.h"
+#include "archive.h"
+
+#define DEFAULT_GAMES 1000
+#define DEFAULT_PLIES 8
+#define DEFAULT_TIME 10
+#define DEFAULT_EMPTIES 12
+#define DEFAULT_TT_SIZE 1
+// thinking time of an engine with a fixed depth - no clock at all
+#define DEPTH_TIME INT_MAX
+#define MAX_LINE 1024
+
+/*
+ * how one engine plays. depth 0 searches until half of timeMs is used,
+ * otherwise exactly depth plies whatever the time, and timeMs is not used.
+ * ttSize is in megabytes, 0 for none.
+ */
+typedef struct {
+    int depth;
+    int timeMs;
+    int empties;
+    int ttSize;
+} Engine;
+
+/*
+ * the games are played in pairs - both games of a pair start from the same
+ * opening, engine A has black in the even game and white in the odd one.
+ */
+typedef struct {
+    Engine engines[2];
+    long games;
+    int plies;
+    uint64_t seed;
+    // openings read from a file, plies random moves if there are none
+    int (*openings)[MAX_PLIES];
+    int *openingLength;
+    int openingCount;
+    // the next game to play, taken by the workers
+    atomic_long next;
+    FILE *records;
+    ArchiveWriter archive;
+    Boolean archiving;
+    // the workers take turns at the records and the archive
+    pthread_mutex_t recordsLock;
+} Tournament;
+
+/*
+ * a worker plays whole games one after the other. every engine has its own
+ * search pool and table in every worker, nothing is shared but the counter.
+ */
+typedef struct {
+    Tournament *tournament;
+    pthread_t tid;
+    SearchPool pools[2];
+    TransTable tts[2];
+    EndgameContext endgame;
+    // results of engine A
+    long wins;
+    long draws;
+    long losses;
+    long moves;
+} Worker;
+
+/*******************************************************************************
+* function name : exitWithError
+* input : message
+* output : -
+* explanation : write to stderr the message and exit with code -1
+*******************************************************************************/
+void exitWithError(char *msg) {
+    perror(msg);
+    exit(-1);
+}
+
+/*******************************************************************************
+* function name : parseEngine
+* input : const char *spec, Engine *engine
+* output : 0 on success, -1 if spec is not an engine
+* explanation : spec is a list of settings like "d4,e10,m2": d depth, t ms
+*               per move, e empty squares of the exact solver, m megabytes
+*               of transposition table. settings left out keep their value.
+*******************************************************************************/
+int parseEngine(const char *spec, Engine *engine) {
+    while (*spec) {
+        char key = *spec++;
+        char *end;
+        long value;
+
+        if (key == ',') {
+            continue;
+        }
+
+        value = strtol(spec, &end, 10);
+        if (end == spec || value < 0) {
+            return -1;
+        }
+        spec = end;
+
+        switch (key) {
+            case 'd': engine->depth = value;
+                break;
+            case 't': engine->timeMs = value;
+                break;
+            case 'e': engine->empties = value;
+                break;
+            case 'm': engine->ttSize = value;
+                break;
+            default:
+                return -1;
+        }
+    }
+
+    if (engine->depth > MAX_DEPTH) {
+        engine->depth = MAX_DEPTH;
+    }
+
+    return 0;
+}
+
+/*******************************************************************************
+* function name : engineText
+* input : const Engine *engine, char *text
+* output : text
+* explanation : the engine's settings for the report.
+*******************************************************************************/
+char *engineText(const Engine *engine, char *text) {
+    if (engine->depth) {
+        sprintf(text, "depth %d", engine->depth);
+    } else {
+        sprintf(text, "%d ms", engine->timeMs);
+    }
+    sprintf(text + strlen(text), ", solves from %d empties, %d mb table",
+            engine->empties, engine->ttSize);
+    return text;
+}
+
+/*******************************************************************************
+* function name : readOpenings
+* input : Tournament *t, const char *path
+* output : -
+* explanation : one opening per line written as squares ("f5d6c3"), like
+*               the game records. lines that aren't openings are skipped.
+*******************************************************************************/
+void readOpenings(Tournament *t, const char *path) {
+    FILE *file = fopen(path, "r");
+    char line[MAX_LINE];
+    int capacity = 0;
+
+    if (!file) {
+        exitWithError("openings open error");
+    }
+
+    while (fgets(line, sizeof(line), file)) {
+        const char *s = line;
+        Position pos;
+        int n = 0;
+
+        initPosition(&pos);
+        while (*s && *s != '#') {
+            int sq;
+
+            if (isspace((unsigned char) *s)) {
+                s++;
+                continue;
+            }
+
+            // passes are played where they have to be
+            if (!strncmp(s, "pa", 2) || !strncmp(s, "--", 2)) {
+                s += 2;
+                continue;
+            }
+
+            if (mustPass(&pos)) {
+                makePass(&pos);
+            }
+
+            if ((sq = parseSquare(s)) < 0 || !makeMove(&pos, sq)) {
+                n = -1;
+                break;
+            }
+
+            if (t->openingCount == capacity) {
+                capacity = capacity ? capacity * 2 : 64;
+                t->openings = realloc(t->openings, capacity * sizeof(*t->openings));
+                t->openingLength = realloc(t->openingLength, capacity * sizeof(int));
+                if (!t->openings || !t->openingLength) {
+                    exitWithError("realloc error");
+                }
+            }
+            t->openings[t->openingCount][n++] = sq;
+            s += 2;
+        }
+
+        if (n > 0) {
+            t->openingLength[t->openingCount++] = n;
+        } else if (n < 0) {
+            fprintf(stderr, "skipping opening: %s", line);
+        }
+    }
+
+    fclose(file);
+}
+
+/*******************************************************************************
+* function name : playOpening
+* input : Tournament *t, long pair, Position *pos, int moves[], int *n
+* output : -
+* explanation : the opening of the games of pair, from the openings file in
+*               turn or plies random moves that depend only on the seed and
+*               pair, so a run can be repeated.
+*******************************************************************************/
+void playOpening(Tournament *t, long pair, Position *pos, int moves[], int *n) {
+    uint64_t state = t->seed ^ ((uint64_t) pair * 0x9e3779b97f4a7c15ULL);
+    int i;
+
+    initPosition(pos);
+    *n = 0;
+
+    if (t->openingCount) {
+        int k = pair % t->openingCount;
+        for (i = 0; i < t->openingLength[k]; i++) {
+            if (mustPass(pos)) {
+                makePass(pos);
+                moves[(*n)++] = PASS_MOVE;
+            }
+            makeMove(pos, t->openings[k][i]);
+            moves[(*n)++] = t->openings[k][i];
+        }
+        return;
+    }
+
+    while (pos->ply < t->plies) {
+        Bitboard legal = pos->legalMoves;
+
+        if (!legal) {
+            if (!mustPass(pos)) {
+                break;
+            }
+            makePass(pos);
+            moves[(*n)++] = PASS_MOVE;
+            continue;
+        }
+
+        for (i = splitMix64(&state) % countDiscs(legal); i > 0; i--) {
+            legal &= legal - 1;
+        }
+        moves[(*n)++] = __builtin_ctzll(legal);
+        makeMove(pos, __builtin_ctzll(legal));
+    }
+}
+
+/*******************************************************************************
+* function name : engineMove
+* input : Worker *w, int e, const Position *pos
+* output : the square engine e plays in pos
+* explanation : the exact solver near the end, the search otherwise.
+*******************************************************************************/
+int engineMove(Worker *w, int e, const Position *pos) {
+    const Engine *engine = &w->tournament->engines[e];
+    SearchPool *pool = &w->pools[e];
+    int empties = SQUARES - pos->discCount[WHITE] - pos->discCount[BLACK];
+    int timeMs = engine->depth ? DEPTH_TIME : engine->timeMs;
+    int sq, score;
+
+    if (empties <= engine->empties) {
+        long long start = nowNs();
+        w->endgame.tt = pool->tt;
+        if (pool->tt) {
+            ttNewSearch(pool->tt);
+        }
+        if (solveEndgame(&w->endgame, pos, timeMs, &sq, &score)) {
+            return sq;
+        }
+        // the search only gets what is left of the move's time
+        timeMs -= (int) ((nowNs() - start) / 1000000);
+        if (timeMs < 1) {
+            timeMs = 1;
+        }
+    }
+
+    return chooseMove(pool, pos, timeMs);
+}
+
+/*******************************************************************************
+* function name : writeRecord
+* input : Worker *w, long game, const int moves[], int n, EndMode result
+* output : -
+* explanation : one line per game, a comment with the game and its result
+*               and then the moves in the format of the server's records.
+*******************************************************************************/
+void writeRecord(Worker *w, long game, const int moves[], int n, EndMode result) {
+    Tournament *t = w->tournament;
+    char text[2 * MAX_PLIES + 1];
+    int i;
+
+    for (i = 0; i < n; i++) {
+        if (moves[i] == PASS_MOVE) {
+            text[2 * i] = '-';
+            text[2 * i + 1] = '-';
+        } else {
+            text[2 * i] = 'a' + moves[i] % BOARD_SIZE;
+            text[2 * i + 1] = '1' + moves[i] / BOARD_SIZE;
+        }
+    }
+    text[2 * n] = '\0';
+
+    pthread_mutex_lock(&t->recordsLock);
+    fprintf(t->records, "%s # game %ld, black %c, %s\n", text, game,
+            game % 2 ? 'B' : 'A', result == BLACK_WIN ? "black wins" :
+            result == WHITE_WIN ? "white wins" : "draw");
+    pthread_mutex_unlock(&t->recordsLock);
+}
+
+/*******************************************************************************
+* function name : archiveRecord
+* input : Worker *w, const int moves[], int n, EndMode result,
+*         uint64_t startMs
+* output : -
+* explanation : add the game to the archive, the moves are squares or
+*               PASS_MOVE as the archive keeps them.
+*******************************************************************************/
+void archiveRecord(Worker *w, const int moves[], int n, EndMode result,
+                   uint64_t startMs) {
+    Tournament *t = w->tournament;
+    uint8_t bytes[MAX_PLIES];
+    int i, error;
+
+    for (i = 0; i < n; i++) {
+        bytes[i] = (uint8_t) moves[i];
+    }
+
+    pthread_mutex_lock(&t->recordsLock);
+    error = archiveAppend(&t->archive, bytes, n, result, startMs,
+                          (uint32_t) (wallMs() - startMs));
+    pthread_mutex_unlock(&t->recordsLock);
+
+    if (error < 0) {
+        exitWithError("archive error");
+    }
+}
+
+/*******************************************************************************
+* function name : playGame
+* input : Worker *w, long game
+* output : -
+* explanation : play game to the end and count its result for engine A.
+*******************************************************************************/
+void playGame(Worker *w, long game) {
+    Tournament *t = w->tournament;
+    int moves[MAX_PLIES];
+    int blackEngine = game % 2;
+    uint64_t startMs = wallMs();
+    Position pos;
+    EndMode result;
+    int n;
+
+    playOpening(t, game / 2, &pos, moves, &n);
+
+    while (n < MAX_PLIES) {
+        int sq;
+
+        if (!pos.legalMoves) {
+            if (!mustPass(&pos)) {
+                break;
+            }
+            makePass(&pos);
+            moves[n++] = PASS_MOVE;
+            continue;
+        }
+
+        sq = engineMove(w, pos.sideToMove == BLACK ? blackEngine : !blackEngine, &pos);
+        makeMove(&pos, sq);
+        moves[n++] = sq;
+    }
+
+    result = positionResult(&pos);
+    if (result == DRAW) {
+        w->draws++;
+    } else if ((result == BLACK_WIN) == (blackEngine == 0)) {
+        w->wins++;
+    } else {
+        w->losses++;
+    }
+    w->moves += n;
+
+    if (t->records) {
+        writeRecord(w, game, moves, n, result);
+    }
+    if (t->archiving) {
+        archiveRecord(w, moves, n, result, startMs);
+    }
+}
+
+/*******************************************************************************
+* function name : workerThread
+* input : void *arg - the Worker
+* output : NULL
+* explanation : take the next game until all the games are taken.
+*******************************************************************************/
+void *workerThread(void *arg) {
+    Worker *w = (Worker *) arg;
+    Tournament *t = w->tournament;
+    long game;
+
+    while ((game = atomic_fetch_add(&t->next, 1)) < t->games) {
+        playGame(w, game);
+    }
+
+    return NULL;
+}
+
+/*******************************************************************************
+* function name : eloDifference
+* input : double score - the share of the points, between 0 and 1
+* output : the rating difference that expects score
+* explanation : -
+*******************************************************************************/
+double eloDifference(double score) {
+    return 400.0 * log10(score / (1.0 - score));
+}
+
+/*******************************************************************************
+* function name : printResults
+* input : long wins, long draws, long losses
+* output : -
+* explanation : score and rating difference of engine A, with a 95% error
+*               margin from the spread of the game results.
+*******************************************************************************/
+void printResults(long wins, long draws, long losses) {
+    long games = wins + draws + losses;
+    double score, variance, margin;
+
+    if (!games) {
+        return;
+    }
+
+    score = (wins + draws / 2.0) / games;
+    printf("engine A: %ld wins, %ld draws, %ld losses, score %.1f%%\n",
+           wins, draws, losses, 100.0 * score);
+
+    if (score <= 0 || score >= 1) {
+        printf("Elo difference: %sinfinite\n", score <= 0 ? "-" : "+");
+        return;
+    }
+
+    variance = (wins * (1 - score) * (1 - score) + draws * (0.5 - score) *
+                (0.5 - score) + losses * score * score) / games;
+    margin = 1.96 * sqrt(variance / games);
+
+    printf("Elo difference: %+.1f", eloDifference(score));
+    if (score - margin > 0 && score + margin < 1) {
+        printf(" +/- %.1f", (eloDifference(score + margin) -
+                             eloDifference(score - margin)) / 2);
+    }
+    printf("\n");
+}
+
+/*******************************************************************************
+* function name : main
+* input : int argc, char **argv
+* output : 0
+* explanation : tournament [-n games] [-j workers] [-a engine] [-b engine]
+*               [-r plies] [-i openings] [-s seed] [-o records] [-A archive]
+*               [-w weights]
+*               plays engine A against engine B and prints the speed and
+*               the results of A.
+*******************************************************************************/
+int main(int argc, char **argv) {
+    Engine defaultEngine = {0, DEFAULT_TIME, DEFAULT_EMPTIES, DEFAULT_TT_SIZE};
+    Tournament t;
+    Worker *workers;
+    const char *openingsPath = NULL, *recordsPath = NULL, *weightsPath = NULL;
+    const char *archivePath = NULL;
+    long wins = 0, draws = 0, losses = 0, moves = 0;
+    int count = sysconf(_SC_NPROCESSORS_ONLN);
+    char text[2][MAX_LINE];
+    long long start;
+    double seconds;
+    int opt, i, e;
+
+    memset(&t, 0, sizeof(t));
+    t.engines[0] = t.engines[1] = defaultEngine;
+    t.games = DEFAULT_GAMES;
+    t.plies = DEFAULT_PLIES;
+    t.seed = 1;
+
+    while ((opt = getopt(argc, argv, "n:j:a:b:r:i:s:o:A:w:")) != -1) {
+        switch (opt) {
+            case 'n': t.games = atol(optarg);
+                break;
+            case 'j': count = atoi(optarg);
+                break;
+            case 'a':
+            case 'b':
+                if (parseEngine(optarg, &t.engines[opt - 'a']) < 0) {
+                    fprintf(stderr, "bad engine: %s\n", optarg);
+                    exit(-1);
+                }
+                break;
+            case 'r': t.plies = atoi(optarg);
+                break;
+            case 'i': openingsPath = optarg;
+                break;
+            case 's': t.seed = strtoull(optarg, NULL, 0);
+                break;
+            case 'o': recordsPath = optarg;
+                break;
+            case 'A': archivePath = optarg;
+                break;
+            case 'w': weightsPath = optarg;
+                break;
+            default:
+                fprintf(stderr, "usage: %s [-n games] [-j workers] [-a engine] "
+                        "[-b engine] [-r plies] [-i openings] [-s seed] "
+                        "[-o records] [-A archive] [-w weights]\n", argv[0]);
+                exit(-1);
+        }
+    }
+
+    if (t.games < 0) t.games = 0;
+    if (count < 1) count = 1;
+
+    // the tables every worker only reads are filled before they start
+    initZobrist();
+    if (weightsPath ? evalLoad(weightsPath) < 0 : evalDefault() < 0) {
+        exitWithError("weights error");
+    }
+
+    if (openingsPath) {
+        readOpenings(&t, openingsPath);
+        if (!t.openingCount) {
+            fprintf(stderr, "no openings in %s\n", openingsPath);
+            exit(-1);
+        }
+    }
+
+    if (recordsPath && !(t.records = fopen(recordsPath, "w"))) {
+        exitWithError("records open error");
+    }
+    if (archivePath) {
+        if (archiveWriterOpen(&t.archive, archivePath) < 0) {
+            exitWithError("archive error");
+        }
+        t.archiving = TRUE;
+    }
+    pthread_mutex_init(&t.recordsLock, NULL);
+
+    if (!(workers = calloc(count, sizeof(Worker)))) {
+        exitWithError("calloc error");
+    }
+
+    for (i = 0; i < count; i++) {
+        workers[i].tournament = &t;
+        for (e = 0; e < 2; e++) {
+            TransTable *tt = NULL;
+            if (t.engines[e].ttSize) {
+                if (ttInit(&workers[i].tts[e], t.engines[e].ttSize) < 0) {
+                    exitWithError("tt error");
+                }
+                tt = &workers[i].tts[e];
+            }
+            // one search thread each, the workers keep the cores busy
+            if (poolInit(&workers[i].pools[e], 1, tt) < 0) {
+                exitWithError("pool error");
+            }
+            if (t.engines[e].depth) {
+                workers[i].pools[e].maxDepth = t.engines[e].depth;
+            }
+        }
+    }
+
+    printf("%ld games, %d workers, %s openings\n", t.games, count,
+           t.openingCount ? "file" : "random");
+    printf("engine A: %s\n", engineText(&t.engines[0], text[0]));
+    printf("engine B: %s\n", engineText(&t.engines[1], text[1]));
+    fflush(stdout);
+
+    atomic_init(&t.next, 0);
+    start = nowNs();
+    for (i = 0; i < count; i++) {
+        if (pthread_create(&workers[i].tid, NULL, workerThread, &workers[i]) != 0) {
+            exitWithError("pthread_create error");
+        }
+    }
+    for (i = 0; i < count; i++) {
+        pthread_join(workers[i].tid, NULL);
+        wins += workers[i].wins;
+        draws += workers[i].draws;
+        losses += workers[i].losses;
+        moves += workers[i].moves;
+    }
+    seconds = (nowNs() - start) / 1e9;
+
+    printf("%ld games in %.3f seconds, %.1f games/sec, %.0f moves/sec\n",
+           t.games, seconds, seconds > 0 ? t.games / seconds : 0.0,
+           seconds > 0 ? moves / seconds : 0.0);
+    printResults(wins, draws, losses);
+
+    for (i = 0; i < count; i++) {
+        for (e = 0; e < 2; e++) {
+            poolFree(&workers[i].pools[e]);
+            if (workers[i].pools[e].tt) {
+                ttFree(&workers[i].tts[e]);
+            }
+        }
+    }
+    free(workers);
+    free(t.openings);
+    free(t.openingLength);
+    if (t.records) {
+        fclose(t.records);
+    }
+    if (t.archiving) {
+        archiveWriterClose(&t.archive);
+    }
+    evalFree();
+
+    return 0;
+}
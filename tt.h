@@ -0,0 +1,255 @@
+/*
+ * Student name : Or Zipori
+ * Student : 302933833
+ * Course Exercise Group : 03
+ * Exercise Name : ex3
+ */
+#ifndef TT_H
+#define TT_H
+
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include "othello.h"
+
+#define CACHE_LINE 64
+#define BUCKET_ENTRIES 4
+#define TT_NO_MOVE 0xff
+// buckets looked at when the fill is estimated
+#define FILL_SAMPLE 1024
+
+typedef enum {TT_NONE = 0, TT_EXACT, TT_LOWER, TT_UPPER} BoundType;
+
+/*
+ * one stored search result, 16 bytes. four of them make a bucket, which is
+ * exactly one cache line, so a probe touches a single line.
+ *
+ * the table is shared by all the search threads without locks. data packs
+ * the result into one word and check is key ^ data, so an entry torn by two
+ * threads writing at once no longer matches its key and is just a miss.
+ */
+typedef struct {
+    uint64_t check;
+    uint64_t data;
+} TTEntry;
+
+typedef struct {
+    TTEntry entries[BUCKET_ENTRIES];
+} __attribute__((aligned(CACHE_LINE))) TTBucket;
+
+// an entry unpacked
+typedef struct {
+    int score;
+    int depth;
+    int bound;
+    int move;
+    int age;
+} TTData;
+
+typedef struct {
+    TTBucket *buckets;
+    uint64_t mask;
+    // bumped on every new search, older entries are replaced first
+    uint8_t age;
+} TransTable;
+
+/*******************************************************************************
+* function name : ttPack
+* input : int score, int depth, int bound, int move, int age
+* output : the data word of an entry
+* explanation : score:16 depth:8 bound:8 move:8 age:8
+*******************************************************************************/
+static inline uint64_t ttPack(int score, int depth, int bound, int move, int age) {
+    return (uint64_t) (uint16_t) score |
+           ((uint64_t) (uint8_t) depth << 16) |
+           ((uint64_t) (uint8_t) bound << 24) |
+           ((uint64_t) (uint8_t) move << 32) |
+           ((uint64_t) (uint8_t) age << 40);
+}
+
+/*******************************************************************************
+* function name : ttUnpack
+* input : uint64_t data, TTData *out
+* output : -
+* explanation : reverse of ttPack.
+*******************************************************************************/
+static inline void ttUnpack(uint64_t data, TTData *out) {
+    out->score = (int16_t) (data & 0xffff);
+    out->depth = (data >> 16) & 0xff;
+    out->bound = (data >> 24) & 0xff;
+    out->move = (data >> 32) & 0xff;
+    out->age = (data >> 40) & 0xff;
+}
+
+/*******************************************************************************
+* function name : ttRead
+* input : const TTEntry *e, uint64_t *check, uint64_t *data
+* output : -
+* explanation : read an entry that other threads may be writing.
+*******************************************************************************/
+static inline void ttRead(const TTEntry *e, uint64_t *check, uint64_t *data) {
+    *check = __atomic_load_n(&e->check, __ATOMIC_RELAXED);
+    *data = __atomic_load_n(&e->data, __ATOMIC_RELAXED);
+}
+
+/*******************************************************************************
+* function name : ttInit
+* input : TransTable *tt, size_t megabytes
+* output : 0 on success, -1 if the memory could not be allocated
+* explanation : allocate the largest power of 2 number of buckets that fits.
+*******************************************************************************/
+static inline int ttInit(TransTable *tt, size_t megabytes) {
+    size_t count = 1;
+    size_t bytes = megabytes * 1024 * 1024;
+
+    while (count * 2 * sizeof(TTBucket) <= bytes) {
+        count *= 2;
+    }
+
+    tt->buckets = aligned_alloc(CACHE_LINE, count * sizeof(TTBucket));
+    if (!tt->buckets) {
+        return -1;
+    }
+
+    memset(tt->buckets, 0, count * sizeof(TTBucket));
+    tt->mask = count - 1;
+    tt->age = 0;
+    return 0;
+}
+
+/*******************************************************************************
+* function name : ttFree
+* input : TransTable *tt
+* output : -
+* explanation : -
+*******************************************************************************/
+static inline void ttFree(TransTable *tt) {
+    free(tt->buckets);
+    tt->buckets = NULL;
+}
+
+/*******************************************************************************
+* function name : ttNewSearch
+* input : TransTable *tt
+* output : -
+* explanation : mark the entries written so far as old. called before the
+*               search threads start.
+*******************************************************************************/
+static inline void ttNewSearch(TransTable *tt) {
+    tt->age++;
+}
+
+/*******************************************************************************
+* function name : ttProbe
+* input : TransTable *tt, uint64_t key, TTData *out
+* output : TRUE if key is stored, its entry is copied to out
+* explanation : -
+*******************************************************************************/
+static inline Boolean ttProbe(TransTable *tt, uint64_t key, TTData *out) {
+    TTBucket *b = &tt->buckets[key & tt->mask];
+    int i;
+
+    for (i = 0; i < BUCKET_ENTRIES; i++) {
+        uint64_t check, data;
+        ttRead(&b->entries[i], &check, &data);
+        if (data && (check ^ data) == key) {
+            ttUnpack(data, out);
+            return TRUE;
+        }
+    }
+
+    return FALSE;
+}
+
+/*******************************************************************************
+* function name : ttStore
+* input : TransTable *tt, uint64_t key, int depth, int bound, int score,
+*         int move
+* output : -
+* explanation : overwrite the entry of key if there is one, else the entry
+*               that is least worth keeping - entries from older searches
+*               first, then the shallowest.
+*******************************************************************************/
+static inline void ttStore(TransTable *tt, uint64_t key, int depth, int bound,
+                           int score, int move) {
+    TTBucket *b = &tt->buckets[key & tt->mask];
+    TTEntry *victim = &b->entries[0];
+    TTData old;
+    int victimWorth = 1 << 30;
+    int age = tt->age;
+    Boolean same = FALSE;
+    uint64_t data;
+    int i;
+
+    for (i = 0; i < BUCKET_ENTRIES; i++) {
+        TTEntry *e = &b->entries[i];
+        uint64_t check, edata;
+        int worth;
+
+        ttRead(e, &check, &edata);
+        if (!edata) {
+            victim = e;
+            break;
+        }
+
+        ttUnpack(edata, &old);
+        if ((check ^ edata) == key) {
+            victim = e;
+            same = TRUE;
+            break;
+        }
+
+        worth = old.depth - 16 * (uint8_t) (age - old.age);
+        if (worth < victimWorth) {
+            victimWorth = worth;
+            victim = e;
+        }
+    }
+
+    // keep a deeper result of this search for the same position
+    if (same && old.age == age && old.depth > depth && bound != TT_EXACT) {
+        return;
+    }
+
+    data = ttPack(score, depth, bound, (move < 0) ? TT_NO_MOVE : move, age);
+    __atomic_store_n(&victim->check, key ^ data, __ATOMIC_RELAXED);
+    __atomic_store_n(&victim->data, data, __ATOMIC_RELAXED);
+}
+
+/*******************************************************************************
+* function name : ttHitRate
+* input : uint64_t probes, uint64_t hits
+* output : percent of the probes that found their position
+* explanation : the counters are kept by each search thread.
+*******************************************************************************/
+static inline double ttHitRate(uint64_t probes, uint64_t hits) {
+    return probes ? 100.0 * hits / probes : 0.0;
+}
+
+/*******************************************************************************
+* function name : ttFill
+* input : const TransTable *tt
+* output : percent of the entries written by the current search
+* explanation : estimated from the first buckets of the table.
+*******************************************************************************/
+static inline double ttFill(const TransTable *tt) {
+    uint64_t buckets = (tt->mask + 1 < FILL_SAMPLE) ? tt->mask + 1 : FILL_SAMPLE;
+    uint64_t used = 0, i;
+    int j;
+
+    for (i = 0; i < buckets; i++) {
+        for (j = 0; j < BUCKET_ENTRIES; j++) {
+            uint64_t check, data;
+            TTData d;
+            ttRead(&tt->buckets[i].entries[j], &check, &data);
+            ttUnpack(data, &d);
+            if (data && d.age == tt->age) {
+                used++;
+            }
+        }
+    }
+
+    return 100.0 * used / (buckets * BUCKET_ENTRIES);
+}
+
+#endif